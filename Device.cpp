@@ -20,6 +20,10 @@ Device::Device() {
     
 }
 
+Device::~Device() {
+    
+}
+
 std::string Device::getVersion() {
     return name + " " + version;
 }
@@ -67,4 +71,45 @@ std::string Device::getValueByName(std::string name) {
     return "none";
 }
 
+deviceValue_t Device::getNumericValueAtIndex(int index) {
+    deviceValue_t value = { DEVICE_VALUE_NONE, 0 };
+    
+    // Devices without a native numeric path fall back to parsing their string values
+    std::string text = this->getValueAtIndex(index);
+    std::string type = this->getTypeAtIndex(index);
+    
+    if (text == "none") {
+        return value;
+    }
+    
+    if (type == "boolean") {
+        value.type = DEVICE_VALUE_BOOLEAN;
+        value.number = (text == "true") ? 1 : 0;
+    }
+    else if (type == "integer") {
+        value.type = DEVICE_VALUE_INTEGER;
+        value.number = atoi(text.c_str());
+    }
+    else if (type == "float") {
+        value.type = DEVICE_VALUE_FLOAT;
+        value.number = atof(text.c_str());
+    }
+    
+    return value;
+}
+
+std::string Device::valueToString(const deviceValue_t &value) {
+    
+    switch (value.type) {
+        case DEVICE_VALUE_INTEGER:
+            return DataManip::dataToString((int)value.number);
+        case DEVICE_VALUE_FLOAT:
+            return DataManip::dataToString((float)value.number, 2);
+        case DEVICE_VALUE_BOOLEAN:
+            return DataManip::dataToString(value.number != 0);
+        default:
+            return "none";
+    }
+}
+
 
@@ -20,6 +20,7 @@
 #include <termios.h>
 #include <fcntl.h>
 #include <string.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include "DataManip.h"
 
@@ -29,10 +30,28 @@
 #  define DPRINT(x) do {} while (0)
 #endif
 
+typedef enum
+{
+    DEVICE_VALUE_NONE,                  // No value available
+    DEVICE_VALUE_INTEGER,
+    DEVICE_VALUE_FLOAT,
+    DEVICE_VALUE_BOOLEAN
+}
+deviceValueType_t;
+
+// A value in numeric form, tagged with how it should be interpreted
+typedef struct
+{
+    deviceValueType_t   type;
+    double              number;
+}
+deviceValue_t;
+
 class Device {
     
 public:
     Device();
+    virtual ~Device();
     
     virtual std::string getVersion();
     virtual std::string getDeviceName();
@@ -44,6 +63,9 @@ public:
     virtual bool isActive();
     virtual std::string getValueByName(std::string name);
     virtual std::string getValueAtIndex(int index) =0;
+    virtual deviceValue_t getNumericValueAtIndex(int index);
+    
+    static std::string valueToString(const deviceValue_t &value);
     
 protected:
     
@@ -0,0 +1,329 @@
+
+/**
+ * \file I2CBusExecutor.cpp
+ *
+ *  Created on 10/16/2026.
+ *  Copyright (c) 2026 Agilatech. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "I2CBusExecutor.h"
+
+namespace i2cbus {
+    
+    std::mutex I2CBusExecutor::registryLock;
+    std::map<std::string, I2CBusExecutor *> I2CBusExecutor::registry;
+    
+    /**
+     * Find the executor for a bus, creating it for the first device. A bus that failed to open is
+     * tried again, so a device can be added once its adapter has appeared.
+     * @param devfile The /dev file. Usually something like /dev/i2c-1
+     * @return the executor, to be given back with release()
+     */
+    I2CBusExecutor *I2CBusExecutor::acquire(std::string devfile) {
+        std::lock_guard<std::mutex> guard(registryLock);
+        
+        I2CBusExecutor *&executor = registry[devfile];
+        if (!executor) {
+            executor = new I2CBusExecutor(devfile);
+        }
+        executor->users++;
+        
+        // The descriptor belongs to the bus thread, so whether it is open is checked there too
+        executor->run(openBus, NULL);
+        
+        return executor;
+    }
+    
+    /**
+     * Give back an executor. The last device on a bus stops its thread and closes the bus.
+     * @param executor as returned by acquire()
+     */
+    void I2CBusExecutor::release(I2CBusExecutor *executor) {
+        std::lock_guard<std::mutex> guard(registryLock);
+        
+        if (--executor->users > 0) {
+            return;
+        }
+        
+        registry.erase(executor->devfile);
+        delete executor;
+    }
+    
+    I2CBusExecutor::I2CBusExecutor(std::string devfile) {
+        this->devfile = devfile;
+        this->thread = std::thread(&I2CBusExecutor::loop, this);
+    }
+    
+    I2CBusExecutor::~I2CBusExecutor() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            this->stopping = true;
+        }
+        wake.notify_all();
+        
+        this->thread.join();
+        
+        if (this->file != -1) {
+            ::close(this->file);
+        }
+    }
+    
+    /**
+     * Queue an operation behind any others on this bus, and block until the bus thread has run it.
+     * Nothing is allocated, so this is cheap enough for every transaction.
+     * @param operation the function to run on the bus thread
+     * @param context passed to the operation
+     * @return what the operation returned
+     */
+    int I2CBusExecutor::run(operation_t operation, void *context) {
+        Job job = { operation, context, 0, false };
+        
+        std::unique_lock<std::mutex> guard(lock);
+        
+        this->queue.push_back(&job);
+        wake.notify_one();
+        
+        finished.wait(guard, [&job] { return job.done; });
+        
+        return job.result;
+    }
+    
+    void I2CBusExecutor::loop() {
+        std::unique_lock<std::mutex> guard(lock);
+        
+        while (true) {
+            wake.wait(guard, [this] { return this->stopping || !this->queue.empty(); });
+            
+            if (this->queue.empty()) {
+                return;
+            }
+            
+            Job *job = this->queue.front();
+            this->queue.pop_front();
+            
+            // Run without the lock, so other threads can queue up behind this transaction
+            guard.unlock();
+            int result = job->operation(*this, job->context);
+            guard.lock();
+            
+            job->result = result;
+            job->done = true;
+            finished.notify_all();
+        }
+    }
+    
+    int I2CBusExecutor::openBus(I2CBusExecutor &bus, void *) {
+        
+        if (bus.file >= 0) {
+            return 0;
+        }
+        
+        if((bus.file = ::open(bus.devfile.c_str(), O_RDWR)) < 0){
+            bus.openError = -errno;
+            std::cerr << "I2CDevice: Failed to open the bus" << std::endl;
+            return bus.openError;
+        }
+        
+        // Not every adapter can do combined transfers, so find out what this one supports
+        if(ioctl(bus.file, I2C_FUNCS, &bus.funcs) < 0){
+            bus.funcs = 0;
+        }
+        
+        bus.openError = 0;
+        bus.selected = 0;
+        
+        return 0;
+    }
+    
+    int I2CBusExecutor::status() {
+        std::lock_guard<std::mutex> guard(lock);
+        return this->openError;
+    }
+    
+    unsigned long I2CBusExecutor::functionality() {
+        std::lock_guard<std::mutex> guard(lock);
+        return this->funcs;
+    }
+    
+    int I2CBusExecutor::fd() {
+        return this->file;
+    }
+    
+    /**
+     * Point plain reads and writes at a device. The ioctl is only made when the address changes.
+     * @param addr The device address on the bus
+     * @return 0 on success, or a negative errno value on failure.
+     */
+    int I2CBusExecutor::select(uint32_t addr) {
+        
+        if (addr == this->selected) {
+            return 0;
+        }
+        
+        if(ioctl(this->file, I2C_SLAVE, addr) < 0){
+            this->selected = 0;
+            return -errno;
+        }
+        
+        this->selected = addr;
+        
+        return 0;
+    }
+    
+    // What a read or write operation works on
+    struct I2CBusIo {
+        uint32_t addr;
+        unsigned char *buffer;
+        size_t length;
+    };
+    
+    // What a write followed by a read works on
+    struct I2CBusWriteRead {
+        uint32_t addr;
+        const unsigned char *out;
+        size_t outLength;
+        unsigned char *in;
+        size_t inLength;
+    };
+    
+    // What a combined transfer works on
+    struct I2CBusTransfer {
+        struct i2c_msg *messages;
+        uint32_t number;
+    };
+    
+    I2CBusTransport::I2CBusTransport() {
+    }
+    
+    I2CBusTransport::~I2CBusTransport() {
+        this->close();
+    }
+    
+    /**
+     * Join the executor for the bus. Unlike the plain device transport, the address is not bound
+     * to a descriptor, and is selected by the bus thread before each plain read or write.
+     * @param devfile The /dev file. Usually something like /dev/i2c-1
+     * @param addr The device address on the bus
+     * @return 0 on success, or a negative errno value on failure.
+     */
+    int I2CBusTransport::open(std::string devfile, uint32_t addr) {
+        this->close();
+        
+        this->executor = I2CBusExecutor::acquire(devfile);
+        this->addr = addr;
+        
+        return this->executor->status();
+    }
+    
+    unsigned long I2CBusTransport::functionality() {
+        return this->executor ? this->executor->functionality() : 0;
+    }
+    
+    int I2CBusTransport::readOperation(I2CBusExecutor &bus, void *context) {
+        I2CBusIo *io = static_cast<I2CBusIo *>(context);
+        
+        int result = bus.select(io->addr);
+        if (result) {
+            return result;
+        }
+        
+        ssize_t count = ::read(bus.fd(), io->buffer, io->length);
+        return (count < 0) ? -errno : (int)count;
+    }
+    
+    int I2CBusTransport::writeOperation(I2CBusExecutor &bus, void *context) {
+        I2CBusIo *io = static_cast<I2CBusIo *>(context);
+        
+        int result = bus.select(io->addr);
+        if (result) {
+            return result;
+        }
+        
+        ssize_t count = ::write(bus.fd(), io->buffer, io->length);
+        return (count < 0) ? -errno : (int)count;
+    }
+    
+    int I2CBusTransport::transferOperation(I2CBusExecutor &bus, void *context) {
+        I2CBusTransfer *transfer = static_cast<I2CBusTransfer *>(context);
+        
+        // The messages carry their own addresses
+        struct i2c_rdwr_ioctl_data data;
+        data.msgs = transfer->messages;
+        data.nmsgs = transfer->number;
+        
+        return (ioctl(bus.fd(), I2C_RDWR, &data) < 0) ? -errno : 0;
+    }
+    
+    // Both transfers in one job, so the bus thread runs nothing else in between
+    int I2CBusTransport::writeReadOperation(I2CBusExecutor &bus, void *context) {
+        I2CBusWriteRead *io = static_cast<I2CBusWriteRead *>(context);
+        
+        int result = bus.select(io->addr);
+        if (result) {
+            return result;
+        }
+        
+        ssize_t count = ::write(bus.fd(), io->out, io->outLength);
+        if (count != (ssize_t)io->outLength) {
+            return (count < 0) ? -errno : -EIO;
+        }
+        
+        count = ::read(bus.fd(), io->in, io->inLength);
+        if (count != (ssize_t)io->inLength) {
+            return (count < 0) ? -errno : -EIO;
+        }
+        
+        return 0;
+    }
+    
+    ssize_t I2CBusTransport::read(unsigned char *buffer, size_t length) {
+        if (!this->executor) {
+            return -EBADF;
+        }
+        
+        I2CBusIo io = { this->addr, buffer, length };
+        return this->executor->run(readOperation, &io);
+    }
+    
+    ssize_t I2CBusTransport::write(const unsigned char *buffer, size_t length) {
+        if (!this->executor) {
+            return -EBADF;
+        }
+        
+        I2CBusIo io = { this->addr, const_cast<unsigned char *>(buffer), length };
+        return this->executor->run(writeOperation, &io);
+    }
+    
+    int I2CBusTransport::transfer(struct i2c_msg *messages, uint32_t number) {
+        if (!this->executor) {
+            return -EBADF;
+        }
+        
+        I2CBusTransfer transfer = { messages, number };
+        return this->executor->run(transferOperation, &transfer);
+    }
+    
+    int I2CBusTransport::writeRead(const unsigned char *out, size_t outLength, unsigned char *in, size_t inLength) {
+        if (!this->executor) {
+            return -EBADF;
+        }
+        
+        I2CBusWriteRead io = { this->addr, out, outLength, in, inLength };
+        return this->executor->run(writeReadOperation, &io);
+    }
+    
+    void I2CBusTransport::close() {
+        if (this->executor) {
+            I2CBusExecutor::release(this->executor);
+            this->executor = NULL;
+        }
+    }
+    
+} /* namespace i2cbus */
@@ -0,0 +1,115 @@
+/**
+ * \file I2CBusExecutor.h
+ *
+ *  Created on 10/16/2026.
+ *  Copyright (c) 2026 Agilatech. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+#ifndef __I2CBusExecutor__
+#define __I2CBusExecutor__
+
+#include <string>
+#include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "I2CTransport.h"
+
+namespace i2cbus {
+    
+    /**
+     * @class I2CBusExecutor
+     * @brief The one thread that talks to a /dev/i2c-N bus. It owns the bus file descriptor and runs
+     * every transaction for every device on the bus, one at a time, so separate buses work in
+     * parallel and nothing interleaves on any one of them.
+     */
+    class I2CBusExecutor {
+        
+    public:
+        // The executor for a bus, started on first use and shared by every device on it
+        static I2CBusExecutor *acquire(std::string devfile);
+        static void release(I2CBusExecutor *executor);
+        
+        // Run an operation on the bus thread and wait for its result
+        typedef int (*operation_t)(I2CBusExecutor &bus, void *context);
+        int run(operation_t operation, void *context);
+        
+        // 0 once the bus is open, or the negative errno value that opening it failed with
+        int status();
+        unsigned long functionality();
+        
+        // For operations only: the bus descriptor, and the slave address for plain reads and writes
+        int fd();
+        int select(uint32_t addr);
+        
+    protected:
+        I2CBusExecutor(std::string devfile);
+        ~I2CBusExecutor();
+        
+        void loop();
+        static int openBus(I2CBusExecutor &bus, void *);
+        
+        struct Job {
+            operation_t operation;
+            void *context;
+            int result;
+            bool done;
+        };
+        
+        std::string devfile;
+        int file = -1;
+        int openError = 0;
+        unsigned long funcs = 0;
+        uint32_t selected = 0;
+        
+        std::thread thread;
+        std::mutex lock;
+        std::condition_variable wake;
+        std::condition_variable finished;
+        std::deque<Job *> queue;
+        bool stopping = false;
+        int users = 0;
+        
+        static std::mutex registryLock;
+        static std::map<std::string, I2CBusExecutor *> registry;
+    };
+    
+    /**
+     * @class I2CBusTransport
+     * @brief A device on a bus served by an I2CBusExecutor, in place of a descriptor of its own
+     */
+    class I2CBusTransport : public I2CTransport {
+        
+    public:
+        I2CBusTransport();
+        ~I2CBusTransport();
+        
+        int open(std::string devfile, uint32_t addr);
+        unsigned long functionality();
+        ssize_t read(unsigned char *buffer, size_t length);
+        ssize_t write(const unsigned char *buffer, size_t length);
+        int transfer(struct i2c_msg *messages, uint32_t number);
+        int writeRead(const unsigned char *out, size_t outLength, unsigned char *in, size_t inLength);
+        void close();
+        
+    protected:
+        static int readOperation(I2CBusExecutor &bus, void *context);
+        static int writeOperation(I2CBusExecutor &bus, void *context);
+        static int transferOperation(I2CBusExecutor &bus, void *context);
+        static int writeReadOperation(I2CBusExecutor &bus, void *context);
+        
+        I2CBusExecutor *executor = NULL;
+        uint32_t addr = 0;
+    };
+    
+} /* namespace i2cbus */
+
+#endif /* __I2CBusExecutor__ */
@@ -21,7 +21,8 @@ namespace i2cbus {
      * Default constructor
      */
     I2CDevice::I2CDevice() {
-        this->file = -1;
+        this->transport = new LinuxI2CTransport();
+        this->ownsTransport = true;
     }
     
     /**
@@ -29,11 +30,18 @@ namespace i2cbus {
      * opens a file handle to the I2C device, which is destroyed when the destructor is called
      * @param devfile The bus number. Usually 0 or 1 on the BBB
      * @param addr The addr ID on the bus.
+     * @param transport The bus to use in place of the /dev/i2c-N device, or NULL for the device itself
      */
-    I2CDevice::I2CDevice(std::string devfile, uint32_t addr) {
+    I2CDevice::I2CDevice(std::string devfile, uint32_t addr, I2CTransport *transport) {
         this->devfile = devfile;
         this->addr = addr;
-        this->file = -1;
+        if (transport) {
+            this->transport = transport;
+        }
+        else {
+            this->transport = new LinuxI2CTransport();
+            this->ownsTransport = true;
+        }
         this->open();
     }
     
@@ -41,7 +49,8 @@ namespace i2cbus {
      * Closes the file on destruction, provided that it has not already been closed.
      */
     I2CDevice::~I2CDevice() {
-        if(file!=-1) this->close();
+        if(opened) this->close();
+        if(ownsTransport) delete this->transport;
     }
     
     /**
@@ -71,66 +80,111 @@ namespace i2cbus {
             return 1;
         }
         
-        if((this->file=::open(this->devfile.c_str(), O_RDWR)) < 0){
-            std::cerr << "I2CDevice: Failed to open the bus" << std::endl;
+        if(this->transport->open(this->devfile, this->addr) < 0){
             return 1;
         }
         
-        if(ioctl(this->file, I2C_SLAVE, this->addr) < 0){
-            std::cerr << "I2CDevice: Failed to connect to the device" << std::endl;
-            return 1;
-        }
+        // Not every adapter can do combined transfers, so find out what this one supports
+        this->funcs = this->transport->functionality();
+        this->opened = true;
         
         return 0;
         
     }
     
+    /**
+     * Turns the result of a read or write into an error code. Short transfers are reported as EIO.
+     * @param result the value returned by the transport
+     * @param expected the number of bytes that should have been transferred
+     * @return 0 on success, or a negative errno value
+     */
+    static int transferResult(ssize_t result, size_t expected) {
+        if (result < 0) {
+            return (int)result;
+        }
+        return ((size_t)result == expected) ? 0 : -EIO;
+    }
+    
+    /**
+     * Write a number of consecutive registers from a caller-supplied buffer, without allocating.
+     * @param fromAddress the first register address to write
+     * @param buffer the values to be written
+     * @param number the number of registers to write, at most I2C_SMBUS_BLOCK_MAX
+     * @return 0 on success, or a negative errno value on failure.
+     */
+    int I2CDevice::writeRegisters(uint32_t fromAddress, const unsigned char *buffer, uint32_t number) {
+        unsigned char data[I2C_SMBUS_BLOCK_MAX + 1];
+        
+        if (number > I2C_SMBUS_BLOCK_MAX) {
+            return -EINVAL;
+        }
+        
+        data[0] = fromAddress;
+        memcpy(data + 1, buffer, number);
+        
+        uint64_t start = LatencyHistogram::now();
+        uint32_t attempt = 0;
+        int result;
+        
+        while (retry(result = transferResult(this->transport->write(data, number + 1), number + 1), attempt)) {
+            attempt++;
+        }
+        
+        account(start, attempt + 1, 0, number + 1, result);
+        return result;
+    }
+    
     /**
      * Write a single byte value to a single register.
      * @param registerAddress The register address
      * @param value The value to be written to the register
-     * @return 1 on failure to write, 0 on success.
+     * @return 0 on success, or a negative errno value on failure.
      */
     int I2CDevice::writeRegister(uint32_t registerAddress, unsigned char value) {
-        unsigned char buffer[2];
-        buffer[0] = registerAddress;
-        buffer[1] = value;
-        if(::write(this->file, buffer, 2)!=2){
-            std::cerr << "I2CDevice: Failed write to the device register" << std::endl;
-            return 1;
-        }
-        return 0;
+        return this->writeRegisters(registerAddress, &value, 1);
     }
     
     /**
      * Write a single value to the I2C device. Used to set up the device to read from a
      * particular address.
      * @param value the value to write to the device
-     * @return 1 on failure to write, 0 on success.
+     * @return 0 on success, or a negative errno value on failure.
      */
     int I2CDevice::write(unsigned char value){
-        unsigned char buffer[1];
-        buffer[0]=value;
-        if (::write(this->file, buffer, 1)!=1){
-            std::cerr << "I2CDevice: Failed to write to the device" << std::endl;
-            return 1;
+        uint64_t start = LatencyHistogram::now();
+        uint32_t attempt = 0;
+        int result;
+        
+        while (retry(result = transferResult(this->transport->write(&value, 1), 1), attempt)) {
+            attempt++;
         }
-        return 0;
+        
+        account(start, attempt + 1, 0, 1, result);
+        return result;
+    }
+    
+    /**
+     * Read a single register value into a caller-supplied byte.
+     * @param registerAddress the address to read from
+     * @param value receives the byte value at the register address
+     * @return 0 on success, or a negative errno value on failure.
+     */
+    int I2CDevice::readRegister(uint32_t registerAddress, unsigned char &value){
+        return this->readRegisters(registerAddress, &value, 1);
     }
     
     /**
      * Read a single register value from the address on the device.
      * @param registerAddress the address to read from
-     * @return the byte value at the register address.
+     * @return the byte value at the register address, or 1 on failure. Use the overload
+     * taking a reference when the failure needs to be told apart from a real value.
      */
     unsigned char I2CDevice::readRegister(uint32_t registerAddress){
-        this->write(registerAddress);
-        unsigned char buffer[1];
-        if(::read(this->file, buffer, 1)!=1){
-            std::cerr << "I2CDevice: Failed to read in the value." << std::endl;
+        unsigned char value;
+        if (this->readRegister(registerAddress, value)) {
             return 1;
         }
-        return buffer[0];
+        return value;
     }
     
     /**
@@ -139,18 +193,73 @@ namespace i2cbus {
      * defaults to 0x00.
      * @param number the number of registers to read from the device
      * @param fromAddress the starting address to read from
-     * @return a pointer of type unsigned char* that points to the first element in the block of registers
+     * @return a pointer to a new[] allocated block of registers, which the caller must delete[],
+     * or NULL on failure. Prefer the overload that fills a caller-supplied buffer.
      */
     unsigned char* I2CDevice::readRegisters(uint32_t number, uint32_t fromAddress){
-        this->write(fromAddress);
         unsigned char* data = new unsigned char[number];
-        if(::read(this->file, data, number)!=(int)number){
-            std::cerr << "I2CDevice: Failed to read in the full buffer." << std::endl;
+        if (this->readRegisters(fromAddress, data, number)) {
+            delete[] data;
             return NULL;
         }
         return data;
     }
     
+    /**
+     * Read a block of consecutive registers into a caller-supplied buffer, without allocating. The
+     * register pointer write and the read are joined by a repeated start, so no other bus master can
+     * get in between them. Adapters without I2C_FUNC_I2C fall back to a separate write and read.
+     * @param fromAddress the starting address to read from
+     * @param buffer the caller's buffer, which must hold at least number bytes
+     * @param number the number of registers to read from the device
+     * @return 0 on success, or a negative errno value on failure.
+     */
+    int I2CDevice::readRegisters(uint32_t fromAddress, unsigned char *buffer, uint32_t number){
+        uint64_t start = LatencyHistogram::now();
+        uint32_t syscalls = 0;
+        uint32_t attempt = 0;
+        int result;
+        
+        while (retry(result = readOnce(fromAddress, buffer, number, syscalls), attempt)) {
+            attempt++;
+        }
+        
+        account(start, syscalls, result ? 0 : number, 1, result);
+        return result;
+    }
+    
+    /**
+     * One attempt at a register block read, without retries.
+     * @param reg the starting address to read from
+     * @param buffer the caller's buffer, which must hold at least number bytes
+     * @param number the number of registers to read from the device
+     * @param syscalls incremented by the number of transport calls made
+     * @return 0 on success, or a negative errno value on failure.
+     */
+    int I2CDevice::readOnce(unsigned char reg, unsigned char *buffer, uint32_t number, uint32_t &syscalls){
+        int result;
+        
+        // The pointer write and the read are two transfers, but must not be split on a shared bus
+        if (!(this->funcs & I2C_FUNC_I2C)) {
+            syscalls += 2;
+            return this->transport->writeRead(&reg, 1, buffer, number);
+        }
+        
+        struct i2c_msg messages[2];
+        messages[0].addr = this->addr;
+        messages[0].flags = 0;
+        messages[0].len = 1;
+        messages[0].buf = &reg;
+        messages[1].addr = this->addr;
+        messages[1].flags = I2C_M_RD;
+        messages[1].len = number;
+        messages[1].buf = buffer;
+        
+        syscalls++;
+        result = this->transport->transfer(messages, 2);
+        return (result < 0) ? result : 0;
+    }
+    
     /**
      * Method to dump the registers to the standard output. It inserts a return character after every
      * 16 values and displays the results in hexadecimal to give a standard output using the HEX() macro
@@ -161,20 +270,116 @@ namespace i2cbus {
     
     void I2CDevice::debugDumpRegisters(uint32_t number){
         std::cerr << "I2CDevice: Dumping Registers for Debug Purposes:" << std::endl;
-        unsigned char *registers = this->readRegisters(number);
-        for(int i=0; i<(int)number; i++){
-            std::cerr << HEX(*(registers+i)) << " ";
-            if (i%16==15) std::cout << std::endl;
+        unsigned char registers[I2C_SMBUS_BLOCK_MAX];
+        for(uint32_t i=0; i<number; i+=I2C_SMBUS_BLOCK_MAX){
+            uint32_t count = std::min<uint32_t>(I2C_SMBUS_BLOCK_MAX, number - i);
+            if (this->readRegisters(i, registers, count)) {
+                break;
+            }
+            for(uint32_t j=0; j<count; j++){
+                std::cerr << HEX(registers[j]) << " ";
+                if ((i+j)%16==15) std::cerr << std::endl;
+            }
         }
         std::cerr << std::dec;
     }
     
     /**
-     * Close the file handles and sets a temporary state to -1.
+     * Close the connection to the bus.
      */
     void I2CDevice::close(){
-        ::close(this->file);
-        this->file = -1;
+        this->transport->close();
+        this->opened = false;
+    }
+    
+    /**
+     * Count one finished transaction.
+     * @param start the time the transaction began, from LatencyHistogram::now()
+     * @param syscalls the number of transport calls it took
+     * @param bytesRead the bytes read back, 0 on failure
+     * @param bytesWritten the bytes written, register pointer included
+     * @param result 0 on success, or a negative errno value
+     */
+    void I2CDevice::account(uint64_t start, uint32_t syscalls, uint32_t bytesRead, uint32_t bytesWritten, int result) {
+        this->transactionLatency.record(LatencyHistogram::now() - start);
+        this->transactions.fetch_add(1, std::memory_order_relaxed);
+        this->syscalls.fetch_add(syscalls, std::memory_order_relaxed);
+        this->bytesRead.fetch_add(bytesRead, std::memory_order_relaxed);
+        this->bytesWritten.fetch_add(bytesWritten, std::memory_order_relaxed);
+        if (result < 0) {
+            this->errors.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    
+    /**
+     * Decide whether a failed transaction gets another attempt, and wait out the backoff if so.
+     * @param result the result of the attempt just made
+     * @param attempt the number of repeats already made
+     * @return true if the transaction should be tried again
+     */
+    bool I2CDevice::retry(int result, uint32_t attempt) {
+        if (!result || !isTransient(result) || (attempt >= this->retryLimit.load(std::memory_order_relaxed))) {
+            return false;
+        }
+        
+        usleep(this->retryBackoff.load(std::memory_order_relaxed) << std::min<uint32_t>(attempt, 16));
+        this->retries.fetch_add(1, std::memory_order_relaxed);
+        
+        return true;
+    }
+    
+    /**
+     * Errors that a repeat of the same transaction may not see: a NACK from a device that was busy,
+     * bus noise or arbitration loss, or an adapter timeout. Anything else, such as a closed or
+     * missing adapter, will fail the same way again.
+     * @param error a negative errno value
+     * @return true if the error is worth a retry
+     */
+    bool I2CDevice::isTransient(int error) {
+        switch (-error) {
+            case EIO:
+            case EREMOTEIO:
+            case ENXIO:
+            case ETIMEDOUT:
+            case EAGAIN:
+                return true;
+            default:
+                return false;
+        }
+    }
+    
+    /**
+     * @param retries how many times a transaction failing with a transient error is repeated, 0 for none
+     * @param backoff the wait in µs before the first repeat, doubled for each one after
+     */
+    void I2CDevice::setRetry(uint32_t retries, uint32_t backoff) {
+        this->retryLimit.store(retries, std::memory_order_relaxed);
+        this->retryBackoff.store(backoff, std::memory_order_relaxed);
+    }
+    
+    /**
+     * @return the bus counters and transaction latency since construction or resetBusStats()
+     */
+    i2cStats_t I2CDevice::getBusStats() {
+        i2cStats_t stats;
+        stats.transactions = this->transactions.load(std::memory_order_relaxed);
+        stats.bytesRead = this->bytesRead.load(std::memory_order_relaxed);
+        stats.bytesWritten = this->bytesWritten.load(std::memory_order_relaxed);
+        stats.syscalls = this->syscalls.load(std::memory_order_relaxed);
+        stats.errors = this->errors.load(std::memory_order_relaxed);
+        stats.retries = this->retries.load(std::memory_order_relaxed);
+        stats.latency = this->transactionLatency.snapshot();
+        return stats;
+    }
+    
+    void I2CDevice::resetBusStats() {
+        this->transactions.store(0, std::memory_order_relaxed);
+        this->bytesRead.store(0, std::memory_order_relaxed);
+        this->bytesWritten.store(0, std::memory_order_relaxed);
+        this->syscalls.store(0, std::memory_order_relaxed);
+        this->errors.store(0, std::memory_order_relaxed);
+        this->retries.store(0, std::memory_order_relaxed);
+        this->transactionLatency.reset();
     }
     
 } /* namespace 12cbus */
@@ -21,6 +21,9 @@
 #include <fcntl.h>
 #include <iomanip>
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <linux/i2c-dev.h>
@@ -32,10 +35,32 @@
 #include <linux/i2c.h>
 #endif
 
+#include <atomic>
+
+#include "I2CTransport.h"
+#include "Stats.h"
+
 #define HEX(x) std::setw(2) << std::setfill('0') << std::hex << (int)(x)
 
+// Transactions that fail with a transient error are repeated, waiting the backoff (µs) before the
+// first repeat and twice as long before each one after that
+#define I2C_DEFAULT_RETRIES       (2)
+#define I2C_DEFAULT_BACKOFF_US    (500)
+
 namespace i2cbus {
     
+    typedef struct
+    {
+        uint64_t              transactions;      // register reads and writes, however many messages each took
+        uint64_t              bytesRead;
+        uint64_t              bytesWritten;      // including register pointers
+        uint64_t              syscalls;          // calls into the transport
+        uint64_t              errors;            // transactions that failed, after any retries
+        uint64_t              retries;           // transactions repeated after a transient error
+        histogramSnapshot_t   latency;           // per transaction
+    }
+    i2cStats_t;
+    
     /**
      * @class I2CDevice
      * @brief Generic I2C Device class that can be used to connect to any type of I2C device and read or write to its registers
@@ -44,7 +69,8 @@ namespace i2cbus {
         
     public:
         I2CDevice();
-        I2CDevice(std::string devfile, uint32_t addr);
+        // Without a transport the device uses /dev/i2c-N. A given transport is not owned, and must outlive the device.
+        I2CDevice(std::string devfile, uint32_t addr, I2CTransport *transport = NULL);
         ~I2CDevice();
         
         void setDevfile(std::string devfile);
@@ -54,13 +80,57 @@ namespace i2cbus {
         unsigned char readRegister(uint32_t registerAddress);
         unsigned char* readRegisters(uint32_t number, uint32_t fromAddress=0);
         int writeRegister(uint32_t registerAddress, unsigned char value);
+        
+        // Allocation-free I/O into caller buffers. These return 0 or a negative errno value.
+        int readRegister(uint32_t registerAddress, unsigned char &value);
+        int readRegisters(uint32_t fromAddress, unsigned char *buffer, uint32_t number);
+        int writeRegisters(uint32_t fromAddress, const unsigned char *buffer, uint32_t number);
+        
+        template <size_t N>
+        int readRegisters(uint32_t fromAddress, unsigned char (&buffer)[N]) {
+            return readRegisters(fromAddress, buffer, N);
+        }
+        
+        template <size_t N>
+        int writeRegisters(uint32_t fromAddress, const unsigned char (&buffer)[N]) {
+            return writeRegisters(fromAddress, buffer, N);
+        }
+        
         void debugDumpRegisters(uint32_t number = 0xff);
         void close();
         
+        // Bus counters since construction or the last reset, safe to read from any thread
+        i2cStats_t getBusStats();
+        void resetBusStats();
+        
+        // Number of repeats for a transaction that failed with a transient error, and the first backoff in µs
+        void setRetry(uint32_t retries, uint32_t backoff);
+        
+        static bool isTransient(int error);
+        
     protected:
+        void account(uint64_t start, uint32_t syscalls, uint32_t bytesRead, uint32_t bytesWritten, int result);
+        bool retry(int result, uint32_t attempt);
+        int readOnce(unsigned char reg, unsigned char *buffer, uint32_t number, uint32_t &syscalls);
+        
+
         std::string devfile = "";
         uint32_t addr = 0;
-        int file;
+        I2CTransport *transport;
+        bool ownsTransport = false;
+        bool opened = false;
+        unsigned long funcs = 0;
+        
+        std::atomic<uint64_t> transactions{0};
+        std::atomic<uint64_t> bytesRead{0};
+        std::atomic<uint64_t> bytesWritten{0};
+        std::atomic<uint64_t> syscalls{0};
+        std::atomic<uint64_t> errors{0};
+        std::atomic<uint64_t> retries{0};
+        
+        std::atomic<uint32_t> retryLimit{I2C_DEFAULT_RETRIES};
+        std::atomic<uint32_t> retryBackoff{I2C_DEFAULT_BACKOFF_US};
+        LatencyHistogram transactionLatency;
     };
     
 } /* namespace i2cbus */
@@ -0,0 +1,109 @@
+
+/**
+ * \file I2CTransport.cpp
+ *
+ *  Created on 10/16/2026.
+ *  Copyright (c) 2026 Agilatech. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "I2CTransport.h"
+
+namespace i2cbus {
+    
+    /**
+     * Write then read, one plain transfer each. A transport that shares its bus overrides this.
+     * @param out the bytes to write, such as a register pointer
+     * @param in the buffer to read into
+     * @return 0 on success, or a negative errno value on failure.
+     */
+    int I2CTransport::writeRead(const unsigned char *out, size_t outLength, unsigned char *in, size_t inLength) {
+        ssize_t result;
+        
+        if ((result = write(out, outLength)) != (ssize_t)outLength) {
+            return (result < 0) ? (int)result : -EIO;
+        }
+        
+        if ((result = read(in, inLength)) != (ssize_t)inLength) {
+            return (result < 0) ? (int)result : -EIO;
+        }
+        
+        return 0;
+    }
+    
+    LinuxI2CTransport::LinuxI2CTransport() {
+    }
+    
+    LinuxI2CTransport::~LinuxI2CTransport() {
+        this->close();
+    }
+    
+    /**
+     * Open the bus and select the slave address for the plain reads and writes that follow.
+     * @param devfile The /dev file. Usually something like /dev/i2c-1
+     * @param addr The device address on the bus
+     * @return 0 on success, or a negative errno value on failure.
+     */
+    int LinuxI2CTransport::open(std::string devfile, uint32_t addr) {
+        int result;
+        
+        this->close();
+        
+        if((this->file=::open(devfile.c_str(), O_RDWR)) < 0){
+            result = -errno;
+            std::cerr << "I2CDevice: Failed to open the bus" << std::endl;
+            return result;
+        }
+        
+        if(ioctl(this->file, I2C_SLAVE, addr) < 0){
+            result = -errno;
+            std::cerr << "I2CDevice: Failed to connect to the device" << std::endl;
+            this->close();
+            return result;
+        }
+        
+        // Not every adapter can do combined transfers, so find out what this one supports
+        if(ioctl(this->file, I2C_FUNCS, &this->funcs) < 0){
+            this->funcs = 0;
+        }
+        
+        return 0;
+    }
+    
+    unsigned long LinuxI2CTransport::functionality() {
+        return this->funcs;
+    }
+    
+    ssize_t LinuxI2CTransport::read(unsigned char *buffer, size_t length) {
+        ssize_t result = ::read(this->file, buffer, length);
+        return (result < 0) ? -errno : result;
+    }
+    
+    ssize_t LinuxI2CTransport::write(const unsigned char *buffer, size_t length) {
+        ssize_t result = ::write(this->file, buffer, length);
+        return (result < 0) ? -errno : result;
+    }
+    
+    int LinuxI2CTransport::transfer(struct i2c_msg *messages, uint32_t number) {
+        struct i2c_rdwr_ioctl_data transfer;
+        transfer.msgs = messages;
+        transfer.nmsgs = number;
+        
+        return (ioctl(this->file, I2C_RDWR, &transfer) < 0) ? -errno : 0;
+    }
+    
+    void LinuxI2CTransport::close() {
+        if (this->file != -1) {
+            ::close(this->file);
+            this->file = -1;
+        }
+        this->funcs = 0;
+    }
+    
+} /* namespace i2cbus */
@@ -0,0 +1,88 @@
+/**
+ * \file I2CTransport.h
+ *
+ *  Created on 10/16/2026.
+ *  Copyright (c) 2026 Agilatech. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef __I2CTransport__
+#define __I2CTransport__
+
+#include <iostream>
+#include <string>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
+
+#ifndef I2C_FUNC_I2C
+#include <linux/i2c.h>
+#endif
+
+namespace i2cbus {
+    
+    /**
+     * @class I2CTransport
+     * @brief The bus operations an I2CDevice is built on. Each transport serves one device address.
+     * Every call returns a negative errno value on failure.
+     */
+    class I2CTransport {
+        
+    public:
+        virtual ~I2CTransport() {}
+        
+        // Connect to the device at addr on the named bus. Returns 0 on success.
+        virtual int open(std::string devfile, uint32_t addr) = 0;
+        
+        // I2C_FUNC_* flags describing what the bus supports
+        virtual unsigned long functionality() = 0;
+        
+        // Plain transfers. Return the number of bytes transferred.
+        virtual ssize_t read(unsigned char *buffer, size_t length) = 0;
+        virtual ssize_t write(const unsigned char *buffer, size_t length) = 0;
+        
+        // Combined transfer with repeated starts, as I2C_RDWR. Returns 0 on success.
+        virtual int transfer(struct i2c_msg *messages, uint32_t number) = 0;
+        
+        // A plain write followed by a plain read, for adapters without combined transfers. A shared
+        // bus runs the two back to back, so no other device's transaction comes in between and
+        // moves the register pointer. Returns 0 on success, and -EIO for a short transfer.
+        virtual int writeRead(const unsigned char *out, size_t outLength, unsigned char *in, size_t inLength);
+        
+        virtual void close() = 0;
+    };
+    
+    /**
+     * @class LinuxI2CTransport
+     * @brief The /dev/i2c-N character device
+     */
+    class LinuxI2CTransport : public I2CTransport {
+        
+    public:
+        LinuxI2CTransport();
+        ~LinuxI2CTransport();
+        
+        int open(std::string devfile, uint32_t addr);
+        unsigned long functionality();
+        ssize_t read(unsigned char *buffer, size_t length);
+        ssize_t write(const unsigned char *buffer, size_t length);
+        int transfer(struct i2c_msg *messages, uint32_t number);
+        void close();
+        
+    protected:
+        int file = -1;
+        unsigned long funcs = 0;
+    };
+    
+} /* namespace i2cbus */
+
+#endif /* __I2CTransport__ */
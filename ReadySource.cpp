@@ -0,0 +1,127 @@
+/**
+ * \file ReadySource.cpp
+ *
+ *  Created on 10/16/2026.
+ *  Copyright (c) 2026 Agilatech. All rights reserved.
+ *
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "ReadySource.h"
+
+/**
+ * Block until the source signals or the timeout expires, consuming the signal if there was one.
+ * @param timeoutMs the longest time to wait, in ms. 0 returns immediately.
+ * @return true if the source signalled, false on timeout or error.
+ */
+bool ReadySource::wait(int timeoutMs) {
+    struct pollfd pfd;
+    pfd.fd = this->fd();
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    
+    int result;
+    do {
+        result = poll(&pfd, 1, timeoutMs);
+    } while ((result < 0) && (errno == EINTR));
+    
+    if ((result <= 0) || !(pfd.revents & POLLIN)) {
+        return false;
+    }
+    
+    this->acknowledge();
+    
+    return true;
+}
+
+/**
+ * Throw away any signals that are already pending, so the next wait() sees only new ones.
+ */
+void ReadySource::drain() {
+    while (this->wait(0)) {}
+}
+
+/**
+ * @param fd a pipe read end or an eventfd
+ * @param owned if true the descriptor is closed along with this object
+ */
+FdReadySource::FdReadySource(int fd, bool owned) {
+    this->file = fd;
+    this->owned = owned;
+}
+
+FdReadySource::~FdReadySource() {
+    if (this->owned && (this->file != -1)) {
+        ::close(this->file);
+    }
+}
+
+int FdReadySource::fd() {
+    return this->file;
+}
+
+void FdReadySource::acknowledge() {
+    // Large enough for the 8 byte eventfd counter, and drains a burst of pipe writes
+    unsigned char buffer[64];
+    if (::read(this->file, buffer, sizeof(buffer)) < 0) {
+        std::cerr << "ReadySource: Failed to acknowledge the signal" << std::endl;
+    }
+}
+
+/**
+ * Request falling edge events on a GPIO line through the character device API. The TSL2561 INT
+ * pin is open drain and active low, so each interrupt shows up as one falling edge.
+ * @param chipfile The gpiochip device, something like /dev/gpiochip0
+ * @param line The line offset on that chip
+ */
+GpioReadySource::GpioReadySource(std::string chipfile, uint32_t line) {
+    
+    int chip = ::open(chipfile.c_str(), O_RDWR);
+    if (chip < 0) {
+        std::cerr << "ReadySource: Failed to open " << chipfile << std::endl;
+        return;
+    }
+    
+    struct gpioevent_request request;
+    memset(&request, 0, sizeof(request));
+    request.lineoffset = line;
+    request.handleflags = GPIOHANDLE_REQUEST_INPUT;
+    request.eventflags = GPIOEVENT_REQUEST_FALLING_EDGE;
+    strncpy(request.consumer_label, "tsl2561", sizeof(request.consumer_label) - 1);
+    
+    if (ioctl(chip, GPIO_GET_LINEEVENT_IOCTL, &request) < 0) {
+        std::cerr << "ReadySource: Failed to request events on line " << line << std::endl;
+    }
+    else {
+        this->file = request.fd;
+    }
+    
+    ::close(chip);
+}
+
+GpioReadySource::~GpioReadySource() {
+    if (this->file != -1) {
+        ::close(this->file);
+    }
+}
+
+bool GpioReadySource::isOpen() {
+    return (this->file != -1);
+}
+
+int GpioReadySource::fd() {
+    return this->file;
+}
+
+void GpioReadySource::acknowledge() {
+    struct gpioevent_data event;
+    if (::read(this->file, &event, sizeof(event)) != sizeof(event)) {
+        std::cerr << "ReadySource: Failed to read the line event" << std::endl;
+    }
+}
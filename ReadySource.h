@@ -0,0 +1,83 @@
+/**
+ * \file ReadySource.h
+ *
+ *  Created on 10/16/2026.
+ *  Copyright (c) 2026 Agilatech. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef __ReadySource__
+#define __ReadySource__
+
+#include <iostream>
+#include <string>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+
+/**
+ * @class ReadySource
+ * @brief Something the driver can block on until the device signals that a conversion is done
+ */
+class ReadySource {
+    
+public:
+    virtual ~ReadySource() {}
+    
+    // Descriptor that becomes readable when the device signals, for use with poll/epoll
+    virtual int fd() = 0;
+    
+    // Consume one pending signal. Only call this once fd() is readable.
+    virtual void acknowledge() = 0;
+    
+    bool wait(int timeoutMs);
+    void drain();
+};
+
+/**
+ * @class FdReadySource
+ * @brief Readiness from an existing pipe or eventfd, mostly useful as a stand-in for tests
+ */
+class FdReadySource : public ReadySource {
+    
+public:
+    FdReadySource(int fd, bool owned = false);
+    ~FdReadySource();
+    
+    virtual int fd();
+    virtual void acknowledge();
+    
+protected:
+    int file;
+    bool owned;
+};
+
+/**
+ * @class GpioReadySource
+ * @brief Readiness from the falling edge of a GPIO line wired to the sensor's INT pin
+ */
+class GpioReadySource : public ReadySource {
+    
+public:
+    GpioReadySource(std::string chipfile, uint32_t line);
+    ~GpioReadySource();
+    
+    bool isOpen();
+    virtual int fd();
+    virtual void acknowledge();
+    
+protected:
+    int file = -1;
+};
+
+#endif /* __ReadySource__ */
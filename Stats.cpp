@@ -0,0 +1,102 @@
+/**
+ * \file Stats.cpp
+ *
+ *  Created on 10/16/2026.
+ *  Copyright (c) 2026 Agilatech. All rights reserved.
+ *
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "Stats.h"
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+/**
+ * Add one duration. Safe to call from any number of threads at once.
+ * @param ns the duration in ns
+ */
+void LatencyHistogram::record(uint64_t ns) {
+    int bucket = (ns < 2) ? 0 : (63 - __builtin_clzll(ns));
+    if (bucket >= STATS_HISTOGRAM_BUCKETS) {
+        bucket = STATS_HISTOGRAM_BUCKETS - 1;
+    }
+    
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(ns, std::memory_order_relaxed);
+    
+    uint64_t seen = max.load(std::memory_order_relaxed);
+    while ((ns > seen) && !max.compare_exchange_weak(seen, ns, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::reset() {
+    for (int i = 0; i < STATS_HISTOGRAM_BUCKETS; i++) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+    count.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * Copy out the current values. Recording may carry on meanwhile, so count and the bucket
+ * totals can disagree by the few durations recorded during the copy.
+ * @return the histogram as plain values
+ */
+histogramSnapshot_t LatencyHistogram::snapshot() {
+    histogramSnapshot_t snapshot;
+    
+    snapshot.count = count.load(std::memory_order_relaxed);
+    snapshot.sum = sum.load(std::memory_order_relaxed);
+    snapshot.max = max.load(std::memory_order_relaxed);
+    for (int i = 0; i < STATS_HISTOGRAM_BUCKETS; i++) {
+        snapshot.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+    }
+    
+    return snapshot;
+}
+
+/**
+ * @param snapshot a snapshot taken from a histogram
+ * @param fraction the share of durations at or below the result, 0.5 for the median
+ * @return the upper bound of the matching bucket, never more than the largest duration seen,
+ * or 0 when nothing has been recorded
+ */
+uint64_t LatencyHistogram::percentile(const histogramSnapshot_t &snapshot, double fraction) {
+    uint64_t total = 0;
+    for (int i = 0; i < STATS_HISTOGRAM_BUCKETS; i++) {
+        total += snapshot.buckets[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    
+    uint64_t rank = (uint64_t)(fraction * total + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    
+    uint64_t seen = 0;
+    for (int i = 0; i < STATS_HISTOGRAM_BUCKETS; i++) {
+        seen += snapshot.buckets[i];
+        if (seen >= rank) {
+            uint64_t bound = (2ULL << i) - 1;
+            return (bound < snapshot.max) ? bound : snapshot.max;
+        }
+    }
+    
+    return snapshot.max;
+}
+
+uint64_t LatencyHistogram::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,62 @@
+/**
+ * \file Stats.h
+ *
+ *  Created on 10/16/2026.
+ *  Copyright (c) 2026 Agilatech. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef __Stats__
+#define __Stats__
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+
+// Bucket i counts durations in [2^i, 2^(i+1)) ns, so 40 buckets reach past 18 minutes
+#define STATS_HISTOGRAM_BUCKETS   (40)
+
+typedef struct
+{
+    uint64_t                  count;
+    uint64_t                  sum;               // ns
+    uint64_t                  max;               // ns
+    uint64_t                  buckets[STATS_HISTOGRAM_BUCKETS];
+}
+histogramSnapshot_t;
+
+/**
+ * @class LatencyHistogram
+ * @brief Log2-bucketed duration histogram. Recording is a few relaxed atomic adds with no lock,
+ * so it is cheap enough to leave on in every hot path.
+ */
+class LatencyHistogram {
+    
+public:
+    LatencyHistogram();
+    
+    void record(uint64_t ns);
+    void reset();
+    histogramSnapshot_t snapshot();
+    
+    // Upper bound of the bucket holding the given fraction (0 to 1) of recorded durations, in ns
+    static uint64_t percentile(const histogramSnapshot_t &snapshot, double fraction);
+    
+    // Monotonic clock in ns, for timing the spans that are recorded
+    static uint64_t now();
+    
+protected:
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> max;
+    std::atomic<uint64_t> buckets[STATS_HISTOGRAM_BUCKETS];
+};
+
+#endif /* __Stats__ */
@@ -19,10 +19,10 @@ const std::string Device::type = "sensor";
 
 const int Device::numValues = Tsl2561Drv::NUM_VALUES;
 
-const std::string Device::valueNames[numValues] = {"lux"};
-const std::string Device::valueTypes[numValues] = {"integer"};
+const std::string Device::valueNames[numValues] = {"lux", "broadband", "infrared", "visible"};
+const std::string Device::valueTypes[numValues] = {"integer", "integer", "integer", "integer"};
 
-Tsl2561Drv::Tsl2561Drv(std::string devfile, uint32_t addr):i2cbus::I2CDevice(devfile,addr) {
+Tsl2561Drv::Tsl2561Drv(std::string devfile, uint32_t addr, i2cbus::I2CTransport *transport):i2cbus::I2CDevice(devfile,addr,transport), watching(false), running(false), history(TSL2561_HISTORY_DEPTH) {
 
     if (initialize()) {
         this->active = true;
@@ -33,299 +33,1519 @@ Tsl2561Drv::Tsl2561Drv(std::string devfile, uint32_t addr):i2cbus::I2CDevice(dev
     
 }
 
+Tsl2561Drv::~Tsl2561Drv() {
+    stopContinuous();
+    stopWatching();
+    stopProbing();
+    delete this->readySource;
+}
+
 std::string Tsl2561Drv::getValueAtIndex(int index) {
+    return getValueAtIndex(index, 0);
+}
+
+std::string Tsl2561Drv::getValueAtIndex(int index, uint32_t maxAge) {
+    return valueToString(getNumericValueAtIndex(index, maxAge));
+}
+
+deviceValue_t Tsl2561Drv::getNumericValueAtIndex(int index) {
+    return getNumericValueAtIndex(index, 0);
+}
+
+deviceValue_t Tsl2561Drv::getNumericValueAtIndex(int index, uint32_t maxAge) {
+    deviceValue_t none = { DEVICE_VALUE_NONE, 0 };
     
     if (!this->active) {
-        return "none";
+        return none;
     }
     
-    if (index < numValues) {
-        return (this->*readFunction[index])();
+    if ((index < 0) || (index >= numValues)) {
+        return none;
     }
-    else {
-        return "none";
+    
+    tsl2561Sample_t sample;
+    
+    if (!getSample(sample, maxAge)) {
+        return none;
     }
+    
+    return (this->*readFunction[index])(sample);
 }
 
-bool Tsl2561Drv::initialize() {
+bool Tsl2561Drv::getValuesAll(deviceValue_t values[NUM_VALUES], uint32_t maxAge, int *error) {
     
-    enable();
+    tsl2561Sample_t sample;
     
-    // Make sure we're actually connected 
-    uint8_t x = readRegister(TSL2561_REGISTER_ID);
-    if (!(x & 0x0A)) {
+    if (!getSample(sample, maxAge, error)) {
         return false;
     }
     
-    switch (gainMult) {
-        case 1: setGain(TSL2561_GAIN_1X);
-            break;
-        case 16: setGain(TSL2561_GAIN_16X);
-            break;
-        default: setGain(TSL2561_GAIN_1X);
+    getValues(sample, values);
+    
+    return true;
+}
+
+void Tsl2561Drv::getValues(const tsl2561Sample_t &sample, deviceValue_t values[NUM_VALUES]) {
+    
+    // Every value comes from the same conversion
+    for (int i = 0; i < NUM_VALUES; i++) {
+        values[i] = (this->*readFunction[i])(sample);
+    }
+}
+
+bool Tsl2561Drv::initialize() {
+    
+    // Start the device in power-down mode at boot. Its registers can be read and written
+    // all the same, so it stays down until the first conversion.
+    disable();
+    
+    // Make sure we're actually connected 
+    uint8_t x = readRegister(TSL2561_COMMAND_BIT | TSL2561_REGISTER_ID);
+    if (!isDeviceId(x)) {
+        return false;
     }
     
     // Changing the integration time controls the sensor resolution
     // TSL2561_INTEGRATIONTIME_402ms  // 16-bit data but slowest conversions 
     // TSL2561_INTEGRATIONTIME_13MS   // fast but low resolution 
     // TSL2561_INTEGRATIONTIME_101MS  // medium resolution and speed   
-    setIntegrationTime(TSL2561_INTEGRATIONTIME_402MS);
-    
-    // Start the device in power-down mode at boot
-    disable();
+    // The default profile is 402ms at 1x gain; setProfile() changes it at runtime
+    setTiming(this->integrationTime, this->gain);
     
     return true;
 }
 
-std::string Tsl2561Drv::readValue0() {
+deviceValue_t Tsl2561Drv::readValue0(const tsl2561Sample_t &sample) {
+    deviceValue_t value = { DEVICE_VALUE_INTEGER, (double)sample.lux };
+    return value;
+}
+
+deviceValue_t Tsl2561Drv::readValue1(const tsl2561Sample_t &sample) {
+    return readChannel(sample, TSL2561_FULLSPECTRUM);
+}
+
+deviceValue_t Tsl2561Drv::readValue2(const tsl2561Sample_t &sample) {
+    return readChannel(sample, TSL2561_INFRARED);
+}
+
+deviceValue_t Tsl2561Drv::readValue3(const tsl2561Sample_t &sample) {
+    return readChannel(sample, TSL2561_VISIBLE);
+}
+
+deviceValue_t Tsl2561Drv::readChannel(const tsl2561Sample_t &sample, uint8_t channel) {
+    deviceValue_t value = { DEVICE_VALUE_INTEGER, 0 };
     
-    if (!this->active) {
-        return "none";
+    switch (channel)
+    {
+        case TSL2561_FULLSPECTRUM:
+            value.number = sample.broadband;
+            break;
+        case TSL2561_INFRARED:
+            value.number = sample.ir;
+            break;
+        default: // Visible is channel 0 less channel 1, which can dip below zero in noise
+            value.number = (sample.broadband > sample.ir) ? (sample.broadband - sample.ir) : 0;
+            break;
+    }
+    
+    return value;
+}
+
+bool Tsl2561Drv::getSample(tsl2561Sample_t &sample, uint32_t maxAge, int *error) {
+    
+    uint64_t start = LatencyHistogram::now();
+    
+    int result = readable();
+    
+    if (!result) {
+        result = countRead(readSample(sample, maxAge), start);
     }
     
-    calcLuminosity();
+    if (error) {
+        *error = result;
+    }
     
-    return DataManip::dataToString((int)calculateLux());
+    return (result == 0);
 }
 
-void Tsl2561Drv::enable(void) {
-    // Enable the device by setting the control bit to 0x03 
-    writeRegister(TSL2561_COMMAND_BIT | TSL2561_REGISTER_CONTROL, TSL2561_CONTROL_POWERON);
+int Tsl2561Drv::beginRead(tsl2561Sample_t &sample, uint32_t maxAge, tsl2561Read_t &read) {
+    
+    read.start = LatencyHistogram::now();
+    
+    int result = readable();
+    
+    if (result) {
+        return result;
+    }
+    
+    if (immediateSample(sample, maxAge, result)) {
+        return countRead(result, read.start);
+    }
+    
+    std::unique_lock<std::mutex> lock(conversionLock);
+    
+    if (claimConversion(lock, this->conversionGeneration, sample, result)) {
+        return countRead(result, read.start);
+    }
+    
+    read.generation = this->conversionGeneration;
+    
+    // A conversion started by another read is only waiting out its integration time, so wait along with it
+    if (this->conversionOpen) {
+        this->converting = false;
+        read.delay = remainingMillis(this->conversionDeadline);
+        lock.unlock();
+        conversionDone.notify_all();
+        return TSL2561_READ_PENDING;
+    }
+    
+    lock.unlock();
+    
+    uint32_t delay;
+    
+    {
+        std::lock_guard<std::mutex> guard(busLock);
+        
+        // Choose the setting from the previous reading before converting, so re-measuring is the exception
+        if (this->autoGain && this->ranged) {
+            applyPredictedRange();
+        }
+        
+        if ((result = startConversion())) {
+            disable();
+        }
+        
+        delay = integrationDelay();
+    }
+    
+    if (result) {
+        recordOutcome(result);
+        publishConversion(sample, result);
+        return countRead(result, read.start);
+    }
+    
+    lock.lock();
+    this->conversionOpen = true;
+    this->conversionAttempt = 0;
+    this->conversionDeadline = LatencyHistogram::now() + (uint64_t)delay * 1000000;
+    this->converting = false;
+    lock.unlock();
+    
+    conversionDone.notify_all();
+    
+    read.delay = delay;
+    
+    return TSL2561_READ_PENDING;
 }
 
-void Tsl2561Drv::disable(void) {
-    // Turn the device off to save power 
-    writeRegister(TSL2561_COMMAND_BIT | TSL2561_REGISTER_CONTROL, TSL2561_CONTROL_POWEROFF);
+int Tsl2561Drv::endRead(tsl2561Sample_t &sample, tsl2561Read_t &read) {
+    
+    std::unique_lock<std::mutex> lock(conversionLock);
+    
+    int result;
+    
+    // Whichever read gets here first after the deadline completes the conversion for all of them
+    if (claimConversion(lock, read.generation, sample, result)) {
+        return countRead(result, read.start);
+    }
+    
+    bool early = (LatencyHistogram::now() < this->conversionDeadline);
+    
+    // INT, where wired, marks the end of the ADC cycle well before the padded deadline. This read
+    // owns the conversion now, so conversionLock can be let go while the bus is taken.
+    if (early) {
+        lock.unlock();
+        {
+            std::lock_guard<std::mutex> guard(busLock);
+            early = !(this->readySource && this->readySource->wait(0));
+        }
+        lock.lock();
+    }
+    
+    // Timers may fire a little early, and auto-ranging may have started the conversion over
+    if (early) {
+        this->converting = false;
+        read.delay = remainingMillis(this->conversionDeadline);
+        lock.unlock();
+        conversionDone.notify_all();
+        return TSL2561_READ_PENDING;
+    }
+    
+    int attempt = this->conversionAttempt;
+    lock.unlock();
+    
+    uint32_t delay = 0;
+    
+    // Continuous or threshold mode was started meanwhile, and the device is already free-running
+    if (this->running || this->watching) {
+        immediateSample(sample, 0, result);
+    }
+    else {
+        std::lock_guard<std::mutex> guard(busLock);
+        
+        if ((result = advanceConversion(attempt)) == TSL2561_READ_PENDING) {
+            delay = integrationDelay();
+        }
+        else if (!result) {
+            sample = storeSample(calculateLux());
+        }
+    }
+    
+    if (result == TSL2561_READ_PENDING) {
+        lock.lock();
+        this->conversionAttempt = attempt;
+        this->conversionDeadline = LatencyHistogram::now() + (uint64_t)delay * 1000000;
+        this->converting = false;
+        lock.unlock();
+        
+        conversionDone.notify_all();
+        
+        read.delay = delay;
+        
+        return TSL2561_READ_PENDING;
+    }
+    
+    recordOutcome(result);
+    publishConversion(sample, result);
+    
+    return countRead(result, read.start);
 }
 
-void Tsl2561Drv::setIntegrationTime(tsl2561IntegrationTime_t time) {
+int Tsl2561Drv::readable() {
+    
+    if (!this->active) {
+        return -ENODEV;
+    }
     
-    enable();
+    if (this->circuitOpen) {
+        // Fail fast rather than spend bus time and a conversion on a sensor that is not answering
+        this->rejectedReads.fetch_add(1, std::memory_order_relaxed);
+        return -EHOSTDOWN;
+    }
     
-    // Update the timing register 
-    writeRegister(TSL2561_COMMAND_BIT | TSL2561_REGISTER_TIMING, time | this->gain);
+    return 0;
+}
+
+int Tsl2561Drv::countRead(int result, uint64_t start) {
     
-    // Update value placeholders 
-    this->integrationTime = time;
+    if (!result) {
+        this->readLatency.record(LatencyHistogram::now() - start);
+        this->reads.fetch_add(1, std::memory_order_relaxed);
+    }
+    else {
+        this->failedReads.fetch_add(1, std::memory_order_relaxed);
+    }
     
-    // Turn the device off to save power 
-    disable();
+    return result;
 }
 
-void Tsl2561Drv::setGain(tsl2561Gain_t gain) {
+bool Tsl2561Drv::immediateSample(tsl2561Sample_t &sample, uint32_t maxAge, int &result) {
+    
+    // In continuous mode the sampler thread has already done the work
+    if (this->running) {
+        result = latestSample(sample) ? 0 : -ETIMEDOUT;
+        if (!result) {
+            this->cachedReads.fetch_add(1, std::memory_order_relaxed);
+        }
+        return true;
+    }
+    
+    // While watching, the device is powered and free-running, so the channels are always current
+    if (this->watching) {
+        {
+            std::lock_guard<std::mutex> guard(busLock);
+            
+            if (!(result = readChannels())) {
+                sample = storeSample(calculateLux());
+            }
+        }
+        
+        recordOutcome(result);
+        
+        return true;
+    }
+    
+    // A recent enough conversion can be handed out again without touching the bus
+    if ((maxAge > 0) && cachedSample(sample, maxAge)) {
+        this->cachedReads.fetch_add(1, std::memory_order_relaxed);
+        result = 0;
+        return true;
+    }
+    
+    return false;
+}
 
-    enable();
+bool Tsl2561Drv::claimConversion(std::unique_lock<std::mutex> &lock, uint64_t generation, tsl2561Sample_t &sample, int &result) {
     
-    // Update the timing register 
-    writeRegister(TSL2561_COMMAND_BIT | TSL2561_REGISTER_TIMING, this->integrationTime | gain);
+    // Join a conversion that another thread is busy with rather than starting another one
+    conversionDone.wait(lock, [this, generation] { return !this->converting || (this->conversionGeneration != generation); });
     
-    // Update value placeholders 
-    this->gain = gain;
+    if (this->conversionGeneration != generation) {
+        sample = this->lastConversion;
+        result = this->lastConversionError;
+        this->sharedReads.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
     
-    // Turn the device off to save power 
-    disable();
+    this->converting = true;
+    
+    return false;
 }
 
-void Tsl2561Drv::calcLuminosity () {
-    bool valid = false;
+void Tsl2561Drv::publishConversion(const tsl2561Sample_t &sample, int result) {
     
-    // If Auto gain disabled get a single reading and continue 
-    if(!this->autoGain)
     {
-        getData ();
-        return;
+        std::lock_guard<std::mutex> guard(conversionLock);
+        
+        this->lastConversion = sample;
+        this->lastConversionError = result;
+        this->converting = false;
+        this->conversionOpen = false;
+        this->conversionGeneration++;
+    }
+    
+    conversionDone.notify_all();
+}
+
+uint32_t Tsl2561Drv::remainingMillis(uint64_t deadline) {
+    uint64_t now = LatencyHistogram::now();
+    return (deadline > now) ? (uint32_t)((deadline - now + 999999) / 1000000) : 0;
+}
+
+int Tsl2561Drv::readSample(tsl2561Sample_t &sample, uint32_t maxAge) {
+    
+    int result;
+    
+    if (immediateSample(sample, maxAge, result)) {
+        return result;
     }
     
-    // Read data until we find a valid range 
-    bool agcCheck = false;
+    std::unique_lock<std::mutex> lock(conversionLock);
     
-    do {
-        uint16_t hi, lo;
+    if (claimConversion(lock, this->conversionGeneration, sample, result)) {
+        return result;
+    }
+    
+    // A conversion started by beginRead() is taken over rather than waited for, since its
+    // endRead() may depend on the thread that is calling here
+    bool open = this->conversionOpen;
+    uint64_t deadline = this->conversionDeadline;
+    int attempt = this->conversionAttempt;
+    lock.unlock();
+    
+    {
+        std::lock_guard<std::mutex> guard(busLock);
         
-        // Get the hi/low threshold for the current integration time 
-        switch(this->integrationTime)
-        {
-            case TSL2561_INTEGRATIONTIME_13MS:
-                hi = TSL2561_AGC_THI_13MS;
-                lo = TSL2561_AGC_TLO_13MS;
-                break;
-            case TSL2561_INTEGRATIONTIME_101MS:
-                hi = TSL2561_AGC_THI_101MS;
-                lo = TSL2561_AGC_TLO_101MS;
-                break;
-            default:
-                hi = TSL2561_AGC_THI_402MS;
-                lo = TSL2561_AGC_TLO_402MS;
-                break;
-        }
-        
-        getData();
-        
-        // Run an auto-gain check if we haven't already done so ... 
-        if (!agcCheck)
-        {
-            if ((this->broadband < lo) && (this->gain == TSL2561_GAIN_1X))
-            {
-                // Increase the gain and try again 
-                setGain(TSL2561_GAIN_16X);
-                // Drop the previous conversion results 
-                getData();
-                // Set a flag to indicate we've adjusted the gain 
-                agcCheck = true;
-            }
-            else if ((this->broadband > hi) && (this->gain == TSL2561_GAIN_16X))
-            {
-                // Drop gain to 1x and try again 
-                setGain(TSL2561_GAIN_1X);
-                // Drop the previous conversion results 
-                getData();
-                // Set a flag to indicate we've adjusted the gain 
-                agcCheck = true;
-            }
-            else
-            {
-                // Nothing to look at here, keep moving ....
-                // Reading is either valid, or we're already at the chips limits
-                valid = true;
+        if (open) {
+            usleep(remainingMillis(deadline) * 1000);
+            
+            while ((result = advanceConversion(attempt)) == TSL2561_READ_PENDING) {
+                usleep(integrationDelay() * 1000);
             }
         }
-        else
-        {
-            // If we've already adjusted the gain once, just return the new results.
-            // This avoids endless loops where a value is at one extreme pre-gain,
-            // and the the other extreme post-gain
-            valid = true;
+        else {
+            result = calcLuminosity();
+        }
+        
+        if (!result) {
+            sample = storeSample(calculateLux());
         }
-    } while (!valid);
+    }
+    
+    recordOutcome(result);
+    publishConversion(sample, result);
+    
+    return result;
 }
 
-uint32_t Tsl2561Drv::calculateLux() {
-    uint32_t chScale;
-    uint32_t channel1;
-    uint32_t channel0;
+bool Tsl2561Drv::startContinuous() {
     
-    // Make sure the sensor isn't saturated! 
-    uint16_t clipThreshold;
-    switch (this->integrationTime)
-    {
-        case TSL2561_INTEGRATIONTIME_13MS:
-            clipThreshold = TSL2561_CLIPPING_13MS;
-            break;
-        case TSL2561_INTEGRATIONTIME_101MS:
-            clipThreshold = TSL2561_CLIPPING_101MS;
-            break;
-        default:
-            clipThreshold = TSL2561_CLIPPING_402MS;
-            break;
+    if (!this->active || this->watching) {
+        return false;
     }
     
-    // Return max value lux if the sensor is saturated 
-    if ((this->broadband > clipThreshold) || (this->ir > clipThreshold))
+    if (this->running) {
+        return true;
+    }
+    
+    // Samples from before continuous mode must not pass for the sampler's first one
     {
-        return TSL2561_MAX_LUX;
+        std::lock_guard<std::mutex> guard(historyLock);
+        this->samplerStart = monotonicMicros();
     }
     
-    // Get the correct scale depending on the intergration time 
-    switch (this->integrationTime)
+    this->running = true;
+    this->sampler = std::thread(&Tsl2561Drv::samplerLoop, this);
+    
+    return true;
+}
+
+void Tsl2561Drv::stopContinuous() {
+    
     {
-        case TSL2561_INTEGRATIONTIME_13MS:
-            chScale = TSL2561_LUX_CHSCALE_TINT0;
-            break;
-        case TSL2561_INTEGRATIONTIME_101MS:
-            chScale = TSL2561_LUX_CHSCALE_TINT1;
-            break;
-        default: // No scaling ... integration time = 402ms 
-            chScale = (1 << TSL2561_LUX_CHSCALE);
-            break;
+        std::lock_guard<std::mutex> guard(samplerLock);
+        this->running = false;
     }
     
-    // Scale for gain (1x or 16x) 
-    if (!this->gain) chScale = chScale << 4;
+    samplerWake.notify_all();
     
-    // Scale the channel values 
-    channel0 = (this->broadband * chScale) >> TSL2561_LUX_CHSCALE;
-    channel1 = (this->ir * chScale) >> TSL2561_LUX_CHSCALE;
+    if (this->sampler.joinable()) {
+        this->sampler.join();
+    }
+}
+
+int Tsl2561Drv::readyFd() {
+    return this->readyFile;
+}
+
+bool Tsl2561Drv::isContinuous() {
+    return this->running;
+}
+
+bool Tsl2561Drv::setReadySource(ReadySource *source) {
     
-    // Find the ratio of the channel values (Channel1/Channel0) 
-    uint32_t ratio1 = 0;
-    if (channel0 != 0) ratio1 = (channel1 << (TSL2561_LUX_RATIOSCALE+1)) / channel0;
+    // The sampler or watcher thread may be blocked on the current source
+    if (this->running || this->watching) {
+        return false;
+    }
     
-    // round the ratio value 
-    uint32_t ratio = (ratio1 + 1) >> 1;
+    std::lock_guard<std::mutex> guard(busLock);
     
-    uint32_t b, m;
+    delete this->readySource;
+    this->readySource = source;
+    this->readyFile = source ? source->fd() : -1;
     
-    if (ratio <= TSL2561_LUX_K1T)
-    {b=TSL2561_LUX_B1T; m=TSL2561_LUX_M1T;}
-    else if (ratio <= TSL2561_LUX_K2T)
-    {b=TSL2561_LUX_B2T; m=TSL2561_LUX_M2T;}
-    else if (ratio <= TSL2561_LUX_K3T)
-    {b=TSL2561_LUX_B3T; m=TSL2561_LUX_M3T;}
-    else if (ratio <= TSL2561_LUX_K4T)
-    {b=TSL2561_LUX_B4T; m=TSL2561_LUX_M4T;}
-    else if (ratio <= TSL2561_LUX_K5T)
-    {b=TSL2561_LUX_B5T; m=TSL2561_LUX_M5T;}
-    else if (ratio <= TSL2561_LUX_K6T)
-    {b=TSL2561_LUX_B6T; m=TSL2561_LUX_M6T;}
-    else if (ratio <= TSL2561_LUX_K7T)
-    {b=TSL2561_LUX_B7T; m=TSL2561_LUX_M7T;}
-    else if (ratio > TSL2561_LUX_K8T)
-    {b=TSL2561_LUX_B8T; m=TSL2561_LUX_M8T;}
+    // Raise INT at the end of every ADC cycle, or not at all without a source to watch it
+    setInterruptControl(source ? (TSL2561_INTR_LEVEL | TSL2561_INTR_PERSIST_ANY) : TSL2561_INTR_DISABLE);
+    clearInterrupt();
     
-    uint32_t temp;
+    return true;
+}
+
+bool Tsl2561Drv::startWatching(uint16_t low, uint16_t high, uint8_t persistence, std::function<void(const tsl2561Sample_t &)> callback) {
     
-    // Do not allow negative lux value 
-    if ((channel1 * m) > (channel0 * b)) {
-        temp = 0;
+    // Events arrive on INT, so a ready source is required
+    if (!this->active || !this->readySource || this->running || this->watching) {
+        return false;
     }
-    else {
-        temp = ((channel0 * b) - (channel1 * m));
+    
+    if ((low > high) || (persistence < TSL2561_INTR_PERSIST_MIN) || (persistence > TSL2561_INTR_PERSIST_MAX)) {
+        return false;
     }
     
-    // Round lsb (2^(LUX_SCALE-1)) 
-    temp += (1 << (TSL2561_LUX_LUXSCALE-1));
+    this->watchLow = low;
+    this->watchHigh = high;
+    this->watchPersistence = persistence;
+    this->watchCallback = callback;
     
-    // Strip off fractional portion 
-    uint32_t lux = temp >> TSL2561_LUX_LUXSCALE;
+    this->watching = true;
+    this->watcher = std::thread(&Tsl2561Drv::watcherLoop, this);
     
-    return lux;
+    return true;
+}
+
+void Tsl2561Drv::stopWatching() {
+    
+    this->watching = false;
+    
+    if (this->watcher.joinable()) {
+        this->watcher.join();
+    }
 }
 
-void Tsl2561Drv::getData () {
+bool Tsl2561Drv::isWatching() {
+    return this->watching;
+}
 
-    enable();
+void Tsl2561Drv::watcherLoop() {
     
-    // Wait x ms for ADC to complete 
-    switch (this->integrationTime)
     {
-        case TSL2561_INTEGRATIONTIME_13MS:
-            usleep(TSL2561_DELAY_INTTIME_13MS * 1000);
-            break;
-        case TSL2561_INTEGRATIONTIME_101MS:
-            usleep(TSL2561_DELAY_INTTIME_101MS * 1000); // KTOWN: Was 102ms
-            break;
-        default:
-            usleep(TSL2561_DELAY_INTTIME_402MS * 1000); // KTOWN: Was 403ms
-            break;
+        std::lock_guard<std::mutex> guard(busLock);
+        
+        this->readySource->drain();
+        
+        enable();
+        
+        setThresholds(this->watchLow, this->watchHigh);
+        
+        // Only interrupt once channel 0 has been outside the window for the persistence count
+        setInterruptControl(TSL2561_INTR_LEVEL | this->watchPersistence);
+        clearInterrupt();
     }
     
-    // Reads a two byte value from channel 0 (visible + infrared) 
-    this->broadband = read16(TSL2561_COMMAND_BIT | TSL2561_WORD_BIT | TSL2561_REGISTER_CHAN0_LOW);
+    // Half the window width, which is kept when the window is re-armed
+    uint32_t margin = (this->watchHigh - this->watchLow) / 2;
     
-    // Reads a two byte value from channel 1 (infrared) 
-    this->ir = read16(TSL2561_COMMAND_BIT | TSL2561_WORD_BIT | TSL2561_REGISTER_CHAN1_LOW);
+    while (this->watching) {
+        
+        // Wake up now and then to notice stopWatching()
+        if (!this->readySource->wait(TSL2561_WATCH_POLL_MS)) {
+            continue;
+        }
+        
+        tsl2561Sample_t sample;
+        int result;
+        
+        {
+            std::lock_guard<std::mutex> guard(busLock);
+            
+            if (!(result = readChannels())) {
+                sample = storeSample(calculateLux());
+                
+                // Re-arm the window around the new reading
+                uint16_t low = (this->broadband > margin) ? (this->broadband - margin) : 0;
+                uint16_t high = ((uint32_t)this->broadband + margin < 0xFFFF) ? (this->broadband + margin) : 0xFFFF;
+                setThresholds(low, high);
+                
+                // Kept for the prober, which restores the window if the sensor comes back from a power loss
+                this->watchLow = low;
+                this->watchHigh = high;
+            }
+            
+            clearInterrupt();
+        }
+        
+        recordOutcome(result);
+        
+        if (!result) {
+            this->watchCallback(sample);
+        }
+    }
     
-    // Turn the device off to save power 
+    std::lock_guard<std::mutex> guard(busLock);
+    
+    // Back to an interrupt after every ADC cycle for ordinary reads
+    setInterruptControl(TSL2561_INTR_LEVEL | TSL2561_INTR_PERSIST_ANY);
+    clearInterrupt();
+    
+    // Turn the device off to save power
     disable();
 }
 
-uint16_t Tsl2561Drv::read16(uint8_t reg) {
-    uint16_t h; uint16_t l;
+int Tsl2561Drv::setThresholds(uint16_t low, uint16_t high) {
+    
+    if ((this->shadowValid & TSL2561_SHADOW_THRESHOLDS) && (low == this->shadowLow) && (high == this->shadowHigh)) {
+        this->skippedWrites.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+    
+    unsigned char data[4] = { (unsigned char)(low & 0xFF), (unsigned char)(low >> 8), (unsigned char)(high & 0xFF), (unsigned char)(high >> 8) };
+    
+    // THRESHHOLDL_LOW through THRESHHOLDH_HIGH in one write
+    int result = writeRegisters(TSL2561_COMMAND_BIT | TSL2561_WORD_BIT | TSL2561_REGISTER_THRESHHOLDL_LOW, data);
+    
+    if (result) {
+        this->shadowValid &= ~TSL2561_SHADOW_THRESHOLDS;
+        return result;
+    }
+    
+    this->shadowLow = low;
+    this->shadowHigh = high;
+    this->shadowValid |= TSL2561_SHADOW_THRESHOLDS;
+    
+    return 0;
+}
+
+void Tsl2561Drv::samplerLoop() {
     
-    l = readRegister(reg);
-    h = readRegister(reg+1);
+    {
+        std::lock_guard<std::mutex> guard(busLock);
+        
+        if (this->readySource) {
+            this->readySource->drain();
+        }
+        
+        // Leave the device powered so the ADC free-runs from here on
+        enable();
+    }
+    
+    std::unique_lock<std::mutex> lock(samplerLock);
     
-    return ((short)h<<8)|(short)l;
+    tsl2561Pacing_t pacing = tsl2561Pacing_t();
+    
+    while (this->running) {
+        
+        // While powered, the ADC starts a new conversion as soon as the last one completes
+        if (this->readySource) {
+            lock.unlock();
+            this->readySource->wait(integrationDelay());
+            lock.lock();
+        }
+        else {
+            std::chrono::steady_clock::time_point deadline(std::chrono::nanoseconds(nextPipelineRead(pacing)));
+            samplerWake.wait_until(lock, deadline, [this] { return !this->running; });
+        }
+        
+        if (!this->running) {
+            break;
+        }
+        
+        // Leave the bus alone until the prober finds the sensor again, checking back once a period
+        // rather than on a deadline that has already passed
+        if (this->circuitOpen) {
+            pacing.lastRead = LatencyHistogram::now();
+            if (this->readySource) {
+                samplerWake.wait_for(lock, std::chrono::milliseconds(integrationDelay()), [this] { return !this->running; });
+            }
+            continue;
+        }
+        
+        std::lock_guard<std::mutex> guard(busLock);
+        
+        pacing.lastRead = LatencyHistogram::now();
+        
+        int result = readChannels();
+        
+        if (this->readySource) {
+            clearInterrupt();
+        }
+        
+        recordOutcome(result);
+        
+        if (result) {
+            continue;
+        }
+        
+        // Without INT, a reading that has not changed may be the last conversion read again
+        if (!this->readySource && !freshReading(pacing)) {
+            continue;
+        }
+        
+        this->conversions.fetch_add(1, std::memory_order_relaxed);
+        
+        storeSample(calculateLux());
+        
+        // Switch settings for the next period; the power cycle restarts the ADC cleanly
+        if (this->autoGain && applyPredictedRange()) {
+            enable();
+        }
+    }
+    
+    lock.unlock();
+    
+    std::lock_guard<std::mutex> guard(busLock);
+    
+    // Turn the device off to save power
+    disable();
+}
+
+/**
+ * When the sampler should next read, without an INT line to tell it. Reads are scheduled on the
+ * ADC's own cycle rather than a padded delay after each read, so time spent on the bus does not
+ * stretch the period. They fall an eighth of a cycle after the conversion they are meant for, on
+ * a period a little shorter than the ADC's, so that oscillator drift makes them early: the
+ * reading then repeats, and freshReading() finds the conversion and re-phases on it. Drifting
+ * late instead would skip conversions without a trace.
+ * @param pacing the sampler's estimate of the ADC cycle
+ * @return the time of the next read (ns)
+ */
+uint64_t Tsl2561Drv::nextPipelineRead(tsl2561Pacing_t &pacing) {
+    
+    uint64_t nominal = (uint64_t)integrationMicros(this->integrationTime) * 1000;
+    
+    // A power-up or a new timing starts the ADC over, and what was learned about its cycle with it
+    if (pacing.poweredUp != this->poweredUp) {
+        uint64_t lastRead = pacing.lastRead;
+        
+        pacing = tsl2561Pacing_t();
+        pacing.poweredUp = this->poweredUp;
+        pacing.anchor = pacing.poweredUp + nominal / 8;
+        pacing.lastRead = lastRead;
+    }
+    
+    if (pacing.hunting) {
+        return pacing.lastRead + nominal / 16;
+    }
+    
+    uint64_t period;
+    
+    if (pacing.still) {
+        // Longer than the cycle of any sensor within 1/16 of nominal, so nothing is read twice
+        period = nominal + nominal / 16;
+    }
+    else if (pacing.period) {
+        period = pacing.period - pacing.period / 256;
+    }
+    else {
+        period = nominal - nominal / 16;
+    }
+    
+    uint64_t first = pacing.anchor + period;
+    
+    if (pacing.lastRead < first) {
+        return first;
+    }
+    
+    // After a late read, the conversions that were missed are gone; rejoin the cycle after it
+    return first + ((pacing.lastRead - first) / period + 1) * period;
+}
+
+/**
+ * Without INT, whether the channels just read hold a conversion the sampler has not stored. A
+ * repeated reading is taken to be the last conversion read early, so the sampler polls until the
+ * next one lands and re-phases its reads on it, and the spacing of those landings gives the real
+ * period. When the channels do not change for over a cycle the scene is still, repeats cannot
+ * be told apart from new conversions, and reads are spaced by more than a cycle instead.
+ * @param pacing the sampler's estimate of the ADC cycle
+ * @return whether to store the reading
+ */
+bool Tsl2561Drv::freshReading(tsl2561Pacing_t &pacing) {
+    
+    uint64_t nominal = (uint64_t)integrationMicros(this->integrationTime) * 1000;
+    bool repeated = pacing.valid && (this->broadband == pacing.broadband) && (this->ir == pacing.ir);
+    
+    if (repeated && !pacing.still) {
+        
+        if (!pacing.hunting) {
+            pacing.hunting = true;
+            pacing.huntStart = pacing.lastRead;
+            return false;
+        }
+        
+        if (pacing.lastRead - pacing.huntStart < nominal + nominal / 8) {
+            return false;
+        }
+        
+        // At least one conversion has completed while polling, with the same result
+        pacing.hunting = false;
+        pacing.still = true;
+        pacing.measuredFrom = 0;
+        pacing.anchor = pacing.lastRead;
+    }
+    else if (pacing.hunting) {
+        
+        // The conversion landed since the previous poll, which places the cycle to within a poll
+        pacing.hunting = false;
+        pacing.anchor = pacing.lastRead + nominal / 8;
+        
+        if (pacing.measuredFrom) {
+            pacing.cycles++;
+            
+            uint64_t measured = (pacing.lastRead - pacing.measuredFrom) / pacing.cycles;
+            
+            // Both ends are late by up to a poll, which a long enough span makes negligible
+            if ((pacing.cycles >= TSL2561_PACE_MEASURE_CYCLES) && (measured > nominal - nominal / 8) && (measured < nominal + nominal / 8)) {
+                pacing.period = measured;
+            }
+        }
+        
+        if (!pacing.measuredFrom || (pacing.cycles >= TSL2561_PACE_REMEASURE_CYCLES)) {
+            pacing.measuredFrom = pacing.lastRead;
+            pacing.cycles = 0;
+        }
+    }
+    else if (pacing.still) {
+        
+        // The scene moves again; conversions may have been skipped while still, so the count starts over
+        if (!repeated) {
+            pacing.still = false;
+            pacing.measuredFrom = 0;
+        }
+    }
+    else if (pacing.measuredFrom) {
+        pacing.cycles++;
+    }
+    
+    pacing.valid = true;
+    pacing.broadband = this->broadband;
+    pacing.ir = this->ir;
+    
+    return true;
+}
+
+tsl2561Sample_t Tsl2561Drv::storeSample(uint32_t lux) {
+    
+    std::lock_guard<std::mutex> guard(historyLock);
+    
+    tsl2561Sample_t &sample = this->newest;
+    sample.timestamp = monotonicMicros();
+    sample.broadband = this->broadband;
+    sample.ir = this->ir;
+    sample.gain = this->gain;
+    sample.integrationTime = this->integrationTime;
+    sample.lux = lux;
+    
+    history.push(sample.timestamp / 1000.0, sample.broadband, sample.ir, (sample.gain == TSL2561_GAIN_16X) ? 16 : 1, integrationMillis(sample.integrationTime), sample.lux);
+    
+    historyReady.notify_all();
+    
+    return sample;
+}
+
+bool Tsl2561Drv::latestSample(tsl2561Sample_t &sample) {
+    
+    std::unique_lock<std::mutex> lock(historyLock);
+    
+    // Right after startContinuous() the first conversion may still be in progress
+    if (!historyReady.wait_for(lock, std::chrono::milliseconds(2 * integrationDelay()), [this] { return (history.size() > 0) && (this->newest.timestamp >= this->samplerStart); })) {
+        return false;
+    }
+    
+    sample = this->newest;
+    
+    return true;
+}
+
+bool Tsl2561Drv::cachedSample(tsl2561Sample_t &sample, uint32_t maxAge) {
+    
+    std::lock_guard<std::mutex> guard(historyLock);
+    
+    if (history.size() == 0) {
+        return false;
+    }
+    
+    if ((monotonicMicros() - this->newest.timestamp) > ((uint64_t)maxAge * 1000)) {
+        return false;
+    }
+    
+    sample = this->newest;
+    
+    return true;
+}
+
+void Tsl2561Drv::setHistoryCapacity(size_t capacity) {
+    std::lock_guard<std::mutex> guard(historyLock);
+    history.setCapacity(std::min<size_t>(capacity, TSL2561_HISTORY_MAX));
+}
+
+size_t Tsl2561Drv::getHistorySize() {
+    std::lock_guard<std::mutex> guard(historyLock);
+    return history.size();
+}
+
+size_t Tsl2561Drv::copyHistory(size_t number, double *timestamp, uint16_t *broadband, uint16_t *ir, uint8_t *gain, uint16_t *integrationTime, uint32_t *lux) {
+    std::lock_guard<std::mutex> guard(historyLock);
+    return history.copy(number, timestamp, broadband, ir, gain, integrationTime, lux);
+}
+
+bool Tsl2561Drv::isDeviceId(unsigned char id) {
+    unsigned char part = id >> 4;
+    return (part == TSL2561_PARTNO_CS) || (part == TSL2561_PARTNO_T_FN_CL);
+}
+
+uint16_t Tsl2561Drv::integrationMillis(tsl2561IntegrationTime_t time) {
+    
+    switch (time)
+    {
+        case TSL2561_INTEGRATIONTIME_13MS:
+            return 13;
+        case TSL2561_INTEGRATIONTIME_101MS:
+            return 101;
+        default:
+            return 402;
+    }
+}
+
+uint32_t Tsl2561Drv::integrationMicros(tsl2561IntegrationTime_t time) {
+    
+    switch (time)
+    {
+        case TSL2561_INTEGRATIONTIME_13MS:
+            return 13700;
+        case TSL2561_INTEGRATIONTIME_101MS:
+            return 101000;
+        default:
+            return 402000;
+    }
+}
+
+void Tsl2561Drv::setCircuitBreaker(uint32_t threshold, uint32_t probeInterval) {
+    this->breakerThreshold = threshold;
+    this->probeInterval = std::max<uint32_t>(probeInterval, 1);
+}
+
+bool Tsl2561Drv::isCircuitOpen() {
+    return this->circuitOpen;
+}
+
+void Tsl2561Drv::recordOutcome(int result) {
+    
+    if (!result) {
+        this->consecutiveFailures = 0;
+        return;
+    }
+    
+    uint32_t failures = ++this->consecutiveFailures;
+    uint32_t threshold = this->breakerThreshold;
+    
+    if ((threshold == 0) || (failures < threshold) || this->circuitOpen.exchange(true)) {
+        return;
+    }
+    
+    this->breakerTrips.fetch_add(1, std::memory_order_relaxed);
+    
+    std::lock_guard<std::mutex> guard(probeLock);
+    
+    if (this->probeStop) {
+        return;
+    }
+    
+    // A prober from an earlier trip has already closed the circuit and is on its way out
+    if (this->prober.joinable()) {
+        this->prober.join();
+    }
+    
+    this->prober = std::thread(&Tsl2561Drv::proberLoop, this);
+}
+
+void Tsl2561Drv::proberLoop() {
+    
+    uint32_t interval = this->probeInterval;
+    
+    while (true) {
+        
+        {
+            std::unique_lock<std::mutex> lock(probeLock);
+            
+            if (probeWake.wait_for(lock, std::chrono::milliseconds(interval), [this] { return this->probeStop; })) {
+                return;
+            }
+        }
+        
+        int result;
+        
+        {
+            std::lock_guard<std::mutex> guard(busLock);
+            result = probe();
+        }
+        
+        // Nothing here may take busLock or probeLock once the circuit is closed
+        if (!result) {
+            this->consecutiveFailures = 0;
+            this->circuitOpen = false;
+            return;
+        }
+        
+        // Back off so that a sensor that stays away costs next to no bus time
+        interval = std::min<uint32_t>(interval * 2, TSL2561_PROBE_MAX_MS);
+    }
+}
+
+int Tsl2561Drv::probe() {
+    
+    int result;
+    unsigned char id;
+    
+    // The sensor may have lost power while it was away, so none of the shadows can be trusted
+    this->shadowValid = 0;
+    
+    if ((result = readRegister(TSL2561_COMMAND_BIT | TSL2561_REGISTER_ID, id))) {
+        return result;
+    }
+    if (!isDeviceId(id)) {
+        return -ENODEV;
+    }
+    
+    // Restore what the driver set up
+    if ((result = setTiming(this->integrationTime, this->gain))) {
+        return result;
+    }
+    
+    // A watched sensor gets its threshold window and persistence back, otherwise INT follows every ADC cycle
+    if (this->watching) {
+        if ((result = setThresholds(this->watchLow, this->watchHigh))) {
+            return result;
+        }
+        setInterruptControl(TSL2561_INTR_LEVEL | this->watchPersistence);
+        clearInterrupt();
+    }
+    else if (this->readySource) {
+        setInterruptControl(TSL2561_INTR_LEVEL | TSL2561_INTR_PERSIST_ANY);
+        clearInterrupt();
+    }
+    
+    // The sampler and the watcher both expect the device to stay powered
+    return (this->running || this->watching) ? enable() : disable();
+}
+
+void Tsl2561Drv::stopProbing() {
+    
+    {
+        std::lock_guard<std::mutex> guard(probeLock);
+        this->probeStop = true;
+    }
+    
+    probeWake.notify_all();
+    
+    if (this->prober.joinable()) {
+        this->prober.join();
+    }
+}
+
+tsl2561Stats_t Tsl2561Drv::getStats() {
+    tsl2561Stats_t stats;
+    
+    stats.reads = this->reads.load(std::memory_order_relaxed);
+    stats.conversions = this->conversions.load(std::memory_order_relaxed);
+    stats.cachedReads = this->cachedReads.load(std::memory_order_relaxed);
+    stats.sharedReads = this->sharedReads.load(std::memory_order_relaxed);
+    stats.rangeRetries = this->rangeRetries.load(std::memory_order_relaxed);
+    stats.failedReads = this->failedReads.load(std::memory_order_relaxed);
+    stats.rejectedReads = this->rejectedReads.load(std::memory_order_relaxed);
+    stats.breakerTrips = this->breakerTrips.load(std::memory_order_relaxed);
+    stats.skippedWrites = this->skippedWrites.load(std::memory_order_relaxed);
+    stats.read = this->readLatency.snapshot();
+    stats.conversionWait = this->conversionWait.snapshot();
+    stats.luxCalculation = this->luxCalculation.snapshot();
+    stats.bus = getBusStats();
+    
+    return stats;
+}
+
+void Tsl2561Drv::resetStats() {
+    this->reads.store(0, std::memory_order_relaxed);
+    this->conversions.store(0, std::memory_order_relaxed);
+    this->cachedReads.store(0, std::memory_order_relaxed);
+    this->sharedReads.store(0, std::memory_order_relaxed);
+    this->rangeRetries.store(0, std::memory_order_relaxed);
+    this->failedReads.store(0, std::memory_order_relaxed);
+    this->rejectedReads.store(0, std::memory_order_relaxed);
+    this->breakerTrips.store(0, std::memory_order_relaxed);
+    this->skippedWrites.store(0, std::memory_order_relaxed);
+    this->readLatency.reset();
+    this->conversionWait.reset();
+    this->luxCalculation.reset();
+    resetBusStats();
+}
+
+uint64_t Tsl2561Drv::monotonicMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int Tsl2561Drv::enable(void) {
+    
+    bool powered = (this->shadowValid & TSL2561_SHADOW_CONTROL) && (this->shadowControl == TSL2561_CONTROL_POWERON);
+    
+    // Enable the device by setting the control bit to 0x03 
+    int result = writeShadowed(TSL2561_REGISTER_CONTROL, TSL2561_CONTROL_POWERON, this->shadowControl, TSL2561_SHADOW_CONTROL);
+    
+    if (!result && !powered) {
+        this->poweredUp = LatencyHistogram::now();
+    }
+    
+    return result;
+}
+
+int Tsl2561Drv::disable(void) {
+    
+    // Any conversion in progress is lost
+    if (!(this->shadowValid & TSL2561_SHADOW_CONTROL) || (this->shadowControl != TSL2561_CONTROL_POWEROFF)) {
+        this->powerCycles++;
+    }
+    
+    // Turn the device off to save power 
+    return writeShadowed(TSL2561_REGISTER_CONTROL, TSL2561_CONTROL_POWEROFF, this->shadowControl, TSL2561_SHADOW_CONTROL);
+}
+
+int Tsl2561Drv::setInterruptControl(uint8_t value) {
+    return writeShadowed(TSL2561_REGISTER_INTERRUPT, value, this->shadowInterrupt, TSL2561_SHADOW_INTERRUPT);
+}
+
+/**
+ * Write a register through its shadow copy. Nothing goes on the bus when the sensor is known to
+ * hold the value already, so callers can state the setting they need without tracking it.
+ * @param reg the register
+ * @param value what it should hold
+ * @param shadow the driver's copy of the register
+ * @param mask the register's bit in shadowValid
+ * @return 0 on success, or a negative errno value on failure.
+ */
+int Tsl2561Drv::writeShadowed(uint8_t reg, uint8_t value, uint8_t &shadow, uint8_t mask) {
+    
+    if ((this->shadowValid & mask) && (shadow == value)) {
+        this->skippedWrites.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+    
+    int result = writeRegister(TSL2561_COMMAND_BIT | reg, value);
+    
+    // After a failed write the register could hold either value
+    if (result) {
+        this->shadowValid &= ~mask;
+        return result;
+    }
+    
+    shadow = value;
+    this->shadowValid |= mask;
+    
+    return 0;
+}
+
+void Tsl2561Drv::setProfile(tsl2561IntegrationTime_t time, tsl2561Gain_t gain, bool autoGain) {
+    
+    std::lock_guard<std::mutex> guard(busLock);
+    
+    this->autoGain = autoGain;
+    
+    if ((time == this->integrationTime) && (gain == this->gain)) {
+        return;
+    }
+    
+    setTiming(time, gain);
+    
+    // The sampler and watcher threads expect the device to stay powered
+    if (this->running || this->watching) {
+        enable();
+    }
+}
+
+void Tsl2561Drv::setIntegrationTime(tsl2561IntegrationTime_t time) {
+    setProfile(time, this->gain, this->autoGain);
+}
+
+void Tsl2561Drv::setGain(tsl2561Gain_t gain) {
+    setProfile(this->integrationTime, gain, this->autoGain);
+}
+
+tsl2561IntegrationTime_t Tsl2561Drv::getIntegrationTime() {
+    return this->integrationTime;
+}
+
+tsl2561Gain_t Tsl2561Drv::getGain() {
+    return this->gain;
+}
+
+bool Tsl2561Drv::getAutoGain() {
+    return this->autoGain;
+}
+
+void Tsl2561Drv::setPackage(tsl2561Package_t package) {
+    this->package = package;
+}
+
+tsl2561Package_t Tsl2561Drv::getPackage() {
+    return this->package;
+}
+
+int Tsl2561Drv::setTiming(tsl2561IntegrationTime_t time, tsl2561Gain_t gain) {
+    
+    bool changing = !(this->shadowValid & TSL2561_SHADOW_TIMING) || (this->shadowTiming != (time | gain));
+    bool powered = (this->shadowValid & TSL2561_SHADOW_CONTROL) && (this->shadowControl == TSL2561_CONTROL_POWERON);
+    
+    // A conversion under way would finish with a mix of the old and new setting, so a running ADC
+    // is stopped for the change and started again after it. A powered-down sensor takes it as is.
+    if (changing && powered) {
+        disable();
+    }
+    
+    // Integration time and gain share the timing register, so both go in one write
+    int result = writeShadowed(TSL2561_REGISTER_TIMING, time | gain, this->shadowTiming, TSL2561_SHADOW_TIMING);
+    
+    // Update value placeholders, only once the device has them, so lux is never calculated for the wrong setting
+    if (!result) {
+        this->integrationTime = time;
+        this->gain = gain;
+    }
+    
+    if (changing && powered) {
+        enable();
+    }
+    
+    return result;
+}
+
+void Tsl2561Drv::setAutoGain(bool enable) {
+    this->autoGain = enable;
+}
+
+// Auto-range candidates, fastest first. Within an integration time, 1x comes before 16x.
+static const struct {
+    tsl2561IntegrationTime_t time;
+    tsl2561Gain_t gain;
+} autoRanges[] = {
+    { TSL2561_INTEGRATIONTIME_13MS,  TSL2561_GAIN_1X },
+    { TSL2561_INTEGRATIONTIME_13MS,  TSL2561_GAIN_16X },
+    { TSL2561_INTEGRATIONTIME_101MS, TSL2561_GAIN_1X },
+    { TSL2561_INTEGRATIONTIME_101MS, TSL2561_GAIN_16X },
+    { TSL2561_INTEGRATIONTIME_402MS, TSL2561_GAIN_1X },
+    { TSL2561_INTEGRATIONTIME_402MS, TSL2561_GAIN_16X }
+};
+
+static const int numAutoRanges = sizeof(autoRanges) / sizeof(autoRanges[0]);
+
+// Relative sensitivity of a setting. Integration times scale as 11:81:322, the same ratios as the lux CHSCALE values.
+static uint32_t rangeSensitivity(tsl2561IntegrationTime_t time, tsl2561Gain_t gain) {
+    uint32_t sensitivity;
+    
+    switch (time)
+    {
+        case TSL2561_INTEGRATIONTIME_13MS:
+            sensitivity = 11;
+            break;
+        case TSL2561_INTEGRATIONTIME_101MS:
+            sensitivity = 81;
+            break;
+        default:
+            sensitivity = 322;
+            break;
+    }
+    
+    return (gain == TSL2561_GAIN_16X) ? (sensitivity << 4) : sensitivity;
+}
+
+static void rangeThresholds(tsl2561IntegrationTime_t time, uint16_t &hi, uint16_t &lo, uint16_t &clip) {
+    
+    switch (time)
+    {
+        case TSL2561_INTEGRATIONTIME_13MS:
+            hi = TSL2561_AGC_THI_13MS;
+            lo = TSL2561_AGC_TLO_13MS;
+            clip = TSL2561_CLIPPING_13MS;
+            break;
+        case TSL2561_INTEGRATIONTIME_101MS:
+            hi = TSL2561_AGC_THI_101MS;
+            lo = TSL2561_AGC_TLO_101MS;
+            clip = TSL2561_CLIPPING_101MS;
+            break;
+        default:
+            hi = TSL2561_AGC_THI_402MS;
+            lo = TSL2561_AGC_TLO_402MS;
+            clip = TSL2561_CLIPPING_402MS;
+            break;
+    }
+}
+
+int Tsl2561Drv::predictRange() {
+    
+    // Scale the last reading to what every other setting would have measured. A clipped
+    // channel is only a lower bound, so the prediction errs towards less sensitive settings.
+    uint32_t current = rangeSensitivity(this->integrationTime, this->gain);
+    uint16_t hi, lo, clip;
+    
+    uint64_t predicted[numAutoRanges];
+    uint64_t predictedIr[numAutoRanges];
+    
+    for (int i = 0; i < numAutoRanges; i++) {
+        uint32_t sensitivity = rangeSensitivity(autoRanges[i].time, autoRanges[i].gain);
+        predicted[i] = ((uint64_t)this->broadband * sensitivity) / current;
+        predictedIr[i] = ((uint64_t)this->ir * sensitivity) / current;
+    }
+    
+    // The fastest setting with enough counts for a good reading, and no risk of saturating
+    for (int i = 0; i < numAutoRanges; i++) {
+        rangeThresholds(autoRanges[i].time, hi, lo, clip);
+        
+        if ((predicted[i] >= lo) && (predicted[i] <= hi) && (predictedIr[i] <= hi)) {
+            return i;
+        }
+    }
+    
+    // Too dark to reach the low threshold anywhere, so take the most sensitive setting that will not saturate
+    for (int i = numAutoRanges - 1; i > 0; i--) {
+        rangeThresholds(autoRanges[i].time, hi, lo, clip);
+        
+        if ((predicted[i] <= hi) && (predictedIr[i] <= hi)) {
+            return i;
+        }
+    }
+    
+    return 0;
+}
+
+bool Tsl2561Drv::applyPredictedRange() {
+    
+    int range = predictRange();
+    
+    if ((autoRanges[range].time == this->integrationTime) && (autoRanges[range].gain == this->gain)) {
+        return false;
+    }
+    
+    return (setTiming(autoRanges[range].time, autoRanges[range].gain) == 0);
+}
+
+bool Tsl2561Drv::readingInRange() {
+    uint16_t hi, lo, clip;
+    
+    rangeThresholds(this->integrationTime, hi, lo, clip);
+    
+    if ((this->broadband > clip) || (this->ir > clip)) {
+        return false;
+    }
+    
+    // A dim reading is fine once there is nothing more sensitive to try
+    bool mostSensitive = (this->integrationTime == autoRanges[numAutoRanges - 1].time) && (this->gain == autoRanges[numAutoRanges - 1].gain);
+    
+    return (this->broadband >= lo) || mostSensitive;
+}
+
+int Tsl2561Drv::calcLuminosity () {
+    
+    // Choose the setting from the previous reading before converting, so re-measuring is the exception
+    if (this->autoGain && this->ranged) {
+        applyPredictedRange();
+    }
+    
+    return convert(0);
+}
+
+int Tsl2561Drv::convert(int attempt) {
+    
+    int result;
+    
+    do {
+        if ((result = getData())) {
+            return result;
+        }
+        this->ranged = true;
+    } while (rangeAgain(attempt++));
+    
+    return 0;
+}
+
+bool Tsl2561Drv::rangeAgain(int attempt) {
+    
+    // Give up after a few tries rather than chase a scene that keeps changing
+    if (!this->autoGain || readingInRange() || (attempt >= TSL2561_AUTORANGE_RETRIES)) {
+        return false;
+    }
+    
+    // The new reading is the better predictor; stop if it points at the setting just used
+    if (!applyPredictedRange()) {
+        return false;
+    }
+    
+    this->rangeRetries.fetch_add(1, std::memory_order_relaxed);
+    
+    return true;
+}
+
+int Tsl2561Drv::advanceConversion(int &attempt) {
+    
+    int result;
+    
+    // A power-down since the start means the ADC cycle was cut short, so it has to be run again
+    if (this->powerCycles == this->conversionCycles) {
+        
+        result = readConversion();
+        disable();
+        
+        this->conversionWait.record(LatencyHistogram::now() - this->conversionStarted);
+        this->conversions.fetch_add(1, std::memory_order_relaxed);
+        
+        if (result) {
+            return result;
+        }
+        this->ranged = true;
+        
+        if (!rangeAgain(attempt)) {
+            return 0;
+        }
+        attempt++;
+    }
+    
+    if ((result = startConversion())) {
+        disable();
+        return result;
+    }
+    
+    return TSL2561_READ_PENDING;
+}
+
+uint32_t Tsl2561Drv::calculateLux() {
+    uint64_t start = LatencyHistogram::now();
+    
+    uint32_t lux = Tsl2561Lux::calculate(this->broadband, this->ir, (this->gain == TSL2561_GAIN_16X) ? 16 : 1, integrationMillis(this->integrationTime), this->package);
+    
+    this->luxCalculation.record(LatencyHistogram::now() - start);
+    
+    return lux;
+}
+
+int Tsl2561Drv::getData () {
+    
+    // A sensor that cannot be powered up is not worth waiting a conversion for
+    int result = startConversion();
+    
+    if (!result) {
+        waitForConversion();
+        result = readConversion();
+    }
+    
+    // Turn the device off to save power, whether or not the read worked
+    disable();
+    
+    return result;
+}
+
+int Tsl2561Drv::startConversion() {
+    
+    // A signal left over from an earlier cycle would end the wait too early
+    if (this->readySource) {
+        this->readySource->drain();
+    }
+    
+    int result = enable();
+    
+    this->conversionCycles = this->powerCycles;
+    this->conversionStarted = LatencyHistogram::now();
+    
+    return result;
+}
+
+int Tsl2561Drv::readConversion() {
+    
+    int result = readChannels();
+    
+    // Release INT so it can signal the next ADC cycle
+    if (!result && this->readySource) {
+        result = clearInterrupt();
+    }
+    
+    return result;
+}
+
+int Tsl2561Drv::readChannels () {
+    unsigned char data[4] = { 0, 0, 0, 0 };
+    
+    // Read CHAN0_LOW through CHAN1_HIGH in one transaction; the word bit makes the
+    // register pointer auto-increment across both channels
+    int result = readRegisters(TSL2561_COMMAND_BIT | TSL2561_WORD_BIT | TSL2561_REGISTER_CHAN0_LOW, data);
+    if (result) {
+        return result;
+    }
+    
+    // Channel 0 (visible + infrared)
+    this->broadband = ((uint16_t)data[1] << 8) | data[0];
+    
+    // Channel 1 (infrared)
+    this->ir = ((uint16_t)data[3] << 8) | data[2];
+    
+    return 0;
+}
+
+void Tsl2561Drv::waitForConversion() {
+    
+    uint64_t start = LatencyHistogram::now();
+    
+    // Without an interrupt line, wait x ms for ADC to complete
+    if (!this->readySource) {
+        usleep(integrationDelay() * 1000);
+    }
+    else {
+        // INT marks the actual end of the ADC cycle; the padded delay is only a fallback
+        this->readySource->wait(integrationDelay());
+    }
+    
+    this->conversionWait.record(LatencyHistogram::now() - start);
+    this->conversions.fetch_add(1, std::memory_order_relaxed);
+}
+
+int Tsl2561Drv::clearInterrupt() {
+    return write(TSL2561_COMMAND_BIT | TSL2561_CLEAR_BIT | TSL2561_REGISTER_INTERRUPT);
+}
+
+uint32_t Tsl2561Drv::integrationDelay() {
+    
+    // Time in ms for the ADC to complete at the current integration time
+    switch (this->integrationTime)
+    {
+        case TSL2561_INTEGRATIONTIME_13MS:
+            return TSL2561_DELAY_INTTIME_13MS;
+        case TSL2561_INTEGRATIONTIME_101MS:
+            return TSL2561_DELAY_INTTIME_101MS; // KTOWN: Was 102ms
+        default:
+            return TSL2561_DELAY_INTTIME_402MS; // KTOWN: Was 403ms
+    }
 }
 
 
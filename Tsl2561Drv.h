@@ -21,7 +21,19 @@
 #include <fcntl.h>
 #include <string.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include "I2CDevice.h"
+#include "ReadySource.h"
+#include "Tsl2561History.h"
+#include "Tsl2561Lux.h"
+#include "Stats.h"
 #include "Device.h"
 #include "DataManip.h"
 
@@ -43,40 +55,28 @@
 #define TSL2561_WORD_BIT          (0x20)    // 1 = read/write word (rather than byte)
 #define TSL2561_BLOCK_BIT         (0x10)    // 1 = using block read/write
 
+// PARTNO, the high nibble of the ID register; the low nibble is the revision
+#define TSL2561_PARTNO_CS         (0x1)     // TSL2561CS
+#define TSL2561_PARTNO_T_FN_CL    (0x5)     // TSL2561T, FN and CL
+
 #define TSL2561_CONTROL_POWERON   (0x03)
 #define TSL2561_CONTROL_POWEROFF  (0x00)
 
-#define TSL2561_LUX_LUXSCALE      (14)      // Scale by 2^14
-#define TSL2561_LUX_RATIOSCALE    (9)       // Scale ratio by 2^9
-#define TSL2561_LUX_CHSCALE       (10)      // Scale channel values by 2^10
-#define TSL2561_LUX_CHSCALE_TINT0 (0x7517)  // 322/11 * 2^TSL2561_LUX_CHSCALE
-#define TSL2561_LUX_CHSCALE_TINT1 (0x0FE7)  // 322/81 * 2^TSL2561_LUX_CHSCALE
-
-// T, FN and CL package values
-#define TSL2561_LUX_K1T           (0x0040)  // 0.125 * 2^RATIO_SCALE
-#define TSL2561_LUX_B1T           (0x01f2)  // 0.0304 * 2^LUX_SCALE
-#define TSL2561_LUX_M1T           (0x01be)  // 0.0272 * 2^LUX_SCALE
-#define TSL2561_LUX_K2T           (0x0080)  // 0.250 * 2^RATIO_SCALE
-#define TSL2561_LUX_B2T           (0x0214)  // 0.0325 * 2^LUX_SCALE
-#define TSL2561_LUX_M2T           (0x02d1)  // 0.0440 * 2^LUX_SCALE
-#define TSL2561_LUX_K3T           (0x00c0)  // 0.375 * 2^RATIO_SCALE
-#define TSL2561_LUX_B3T           (0x023f)  // 0.0351 * 2^LUX_SCALE
-#define TSL2561_LUX_M3T           (0x037b)  // 0.0544 * 2^LUX_SCALE
-#define TSL2561_LUX_K4T           (0x0100)  // 0.50 * 2^RATIO_SCALE
-#define TSL2561_LUX_B4T           (0x0270)  // 0.0381 * 2^LUX_SCALE
-#define TSL2561_LUX_M4T           (0x03fe)  // 0.0624 * 2^LUX_SCALE
-#define TSL2561_LUX_K5T           (0x0138)  // 0.61 * 2^RATIO_SCALE
-#define TSL2561_LUX_B5T           (0x016f)  // 0.0224 * 2^LUX_SCALE
-#define TSL2561_LUX_M5T           (0x01fc)  // 0.0310 * 2^LUX_SCALE
-#define TSL2561_LUX_K6T           (0x019a)  // 0.80 * 2^RATIO_SCALE
-#define TSL2561_LUX_B6T           (0x00d2)  // 0.0128 * 2^LUX_SCALE
-#define TSL2561_LUX_M6T           (0x00fb)  // 0.0153 * 2^LUX_SCALE
-#define TSL2561_LUX_K7T           (0x029a)  // 1.3 * 2^RATIO_SCALE
-#define TSL2561_LUX_B7T           (0x0018)  // 0.00146 * 2^LUX_SCALE
-#define TSL2561_LUX_M7T           (0x0012)  // 0.00112 * 2^LUX_SCALE
-#define TSL2561_LUX_K8T           (0x029a)  // 1.3 * 2^RATIO_SCALE
-#define TSL2561_LUX_B8T           (0x0000)  // 0.000 * 2^LUX_SCALE
-#define TSL2561_LUX_M8T           (0x0000)  // 0.000 * 2^LUX_SCALE
+// Interrupt control register fields
+#define TSL2561_INTR_DISABLE      (0x00)    // Interrupt output disabled
+#define TSL2561_INTR_LEVEL        (0x10)    // Level interrupt, held until cleared
+#define TSL2561_INTR_PERSIST_ANY  (0x00)    // Interrupt after every ADC cycle
+#define TSL2561_INTR_PERSIST_MIN  (1)       // Interrupt on any value outside the threshold window
+#define TSL2561_INTR_PERSIST_MAX  (15)      // Interrupt after 15 periods outside the window
+
+// Registers the driver keeps a shadow copy of, as bits of the mask of those it can trust
+#define TSL2561_SHADOW_CONTROL    (0x01)
+#define TSL2561_SHADOW_TIMING     (0x02)
+#define TSL2561_SHADOW_INTERRUPT  (0x04)
+#define TSL2561_SHADOW_THRESHOLDS (0x08)
+
+// How often the watcher thread checks whether it has been stopped, in ms
+#define TSL2561_WATCH_POLL_MS     (250)
 
 // Auto-gain thresholds
 #define TSL2561_AGC_THI_13MS      (4850)    // Max value at Ti 13ms = 5047
@@ -86,12 +86,26 @@
 #define TSL2561_AGC_THI_402MS     (63000)   // Max value at Ti 402ms = 65535
 #define TSL2561_AGC_TLO_402MS     (500)
 
-// Clipping thresholds
-#define TSL2561_CLIPPING_13MS     (4900)
-#define TSL2561_CLIPPING_101MS    (37000)
-#define TSL2561_CLIPPING_402MS    (65000)
+// Conversions the auto-ranging engine may repeat when its prediction was wrong
+#define TSL2561_AUTORANGE_RETRIES (2)
+
+// Returned by beginRead() and endRead() while the read waits for a conversion
+#define TSL2561_READ_PENDING      (1)
 
-#define TSL2561_MAX_LUX             21001
+// Number of completed samples retained for export, unless resized
+#define TSL2561_HISTORY_DEPTH     (64)
+#define TSL2561_HISTORY_MAX       (1 << 20) // Largest history capacity, about 20MB of samples
+
+// Consecutive failed reads that open the circuit breaker, and how often an unreachable sensor
+// is probed in ms. The probe interval doubles after each failed probe, up to the maximum.
+#define TSL2561_BREAKER_THRESHOLD (3)
+#define TSL2561_PROBE_INTERVAL_MS (1000)
+#define TSL2561_PROBE_MAX_MS      (30000)
+
+// Conversions a measured ADC period has to span before continuous mode paces its reads on it
+// without INT, and the span after which the measurement starts over to follow a drifting clock
+#define TSL2561_PACE_MEASURE_CYCLES   (32)
+#define TSL2561_PACE_REMEASURE_CYCLES (128)
 
 enum
 {
@@ -125,41 +139,297 @@ typedef enum
 }
 tsl2561Gain_t;
 
+typedef struct
+{
+    uint64_t                  timestamp;         // Monotonic time of completion, in microseconds
+    uint16_t                  broadband;         // Channel 0 counts
+    uint16_t                  ir;                // Channel 1 counts
+    tsl2561Gain_t             gain;
+    tsl2561IntegrationTime_t  integrationTime;
+    uint32_t                  lux;
+}
+tsl2561Sample_t;
+
+// A read split around the conversion wait, carried from beginRead() to endRead()
+typedef struct
+{
+    uint64_t                  generation;        // conversion the read is waiting on
+    uint64_t                  start;             // ns, for the read latency
+    uint32_t                  delay;             // ms to wait before calling endRead()
+}
+tsl2561Read_t;
+
+// Where continuous mode places the ADC cycle when there is no INT line to say so; times in ns
+typedef struct
+{
+    uint64_t                  poweredUp;         // the power-up this estimate belongs to
+    uint64_t                  anchor;            // reads fall on anchor + n periods
+    uint64_t                  period;            // measured length of a cycle, 0 until measured
+    uint64_t                  measuredFrom;      // the conversion the measurement counts from, or 0
+    uint32_t                  cycles;            // conversions stored since then
+    uint64_t                  lastRead;
+    uint64_t                  huntStart;         // when the channels were first seen not to change
+    bool                      hunting;           // polling for a conversion that has not landed yet
+    bool                      still;             // the channels stopped changing for a whole cycle
+    bool                      valid;             // a reading has been stored since power-up
+    uint16_t                  broadband;         // the channels of that reading
+    uint16_t                  ir;
+}
+tsl2561Pacing_t;
+
+typedef struct
+{
+    uint64_t                  reads;             // getSample() calls that returned a sample
+    uint64_t                  conversions;       // ADC cycles waited out, auto-range repeats included
+    uint64_t                  cachedReads;       // reads answered from continuous mode or the maxAge cache
+    uint64_t                  sharedReads;       // reads that joined a conversion already under way
+    uint64_t                  rangeRetries;      // conversions repeated because the reading was out of range
+    uint64_t                  failedReads;       // reads that returned an error
+    uint64_t                  rejectedReads;     // reads refused at once while the circuit breaker was open
+    uint64_t                  breakerTrips;      // times the circuit breaker opened
+    uint64_t                  skippedWrites;     // register writes left out because the sensor already held the value
+    histogramSnapshot_t       read;              // getSample(), from call to return
+    histogramSnapshot_t       conversionWait;    // sleep or INT wait for the ADC
+    histogramSnapshot_t       luxCalculation;
+    i2cbus::i2cStats_t        bus;
+}
+tsl2561Stats_t;
+
 class Tsl2561Drv : public i2cbus::I2CDevice, public Device {
 
 public:
-    Tsl2561Drv(std::string devfile, uint32_t addr);
+    // transport replaces the /dev/i2c-N device, for instance with a Tsl2561Sim; it must outlive the driver
+    Tsl2561Drv(std::string devfile, uint32_t addr, i2cbus::I2CTransport *transport = NULL);
+    ~Tsl2561Drv();
     virtual std::string getValueAtIndex(int index);
     
-    static const int NUM_VALUES = 1;
+    // maxAge is in ms; a completed conversion younger than that is returned without a new read
+    std::string getValueAtIndex(int index, uint32_t maxAge);
+    virtual deviceValue_t getNumericValueAtIndex(int index);
+    deviceValue_t getNumericValueAtIndex(int index, uint32_t maxAge);
+    
+    // On failure, error receives a negative errno value: a bus error as reported by the adapter,
+    // ENODEV for a sensor that never initialized, EHOSTDOWN while the circuit breaker is open,
+    // or ETIMEDOUT when continuous mode has produced no sample.
+    bool getSample(tsl2561Sample_t &sample, uint32_t maxAge = 0, int *error = NULL);
+    
+    static const int NUM_VALUES = 4;
+    
+    // All values (lux, broadband, infrared, visible) from a single conversion
+    bool getValuesAll(deviceValue_t values[NUM_VALUES], uint32_t maxAge = 0, int *error = NULL);
+    void getValues(const tsl2561Sample_t &sample, deviceValue_t values[NUM_VALUES]);
+    
+    // getSample() in two halves, for callers that wait out the conversion on their own timer
+    // instead of blocking a thread. Both return 0 with the sample, a negative errno value, or
+    // TSL2561_READ_PENDING when endRead() should be called once read.delay ms have passed.
+    // Neither call holds the bus for longer than a few transactions.
+    int beginRead(tsl2561Sample_t &sample, uint32_t maxAge, tsl2561Read_t &read);
+    int endRead(tsl2561Sample_t &sample, tsl2561Read_t &read);
+    
+    // Continuous mode keeps the sensor powered and samples every integration period. Each read
+    // happens while the next conversion integrates, so the rate is one sample per period.
+    bool startContinuous();
+    void stopContinuous();
+    bool isContinuous();
+    
+    // Acquisition profile. Each change is a single TIMING register write. With auto gain on,
+    // auto-ranging picks integration time and gain from the previous reading.
+    void setProfile(tsl2561IntegrationTime_t time, tsl2561Gain_t gain, bool autoGain);
+    void setIntegrationTime(tsl2561IntegrationTime_t time);
+    void setGain(tsl2561Gain_t gain);
+    void setAutoGain(bool enable);
+    tsl2561IntegrationTime_t getIntegrationTime();
+    tsl2561Gain_t getGain();
+    bool getAutoGain();
+    
+    // Package of the sensor on the board, which selects the lux equation
+    void setPackage(tsl2561Package_t package);
+    tsl2561Package_t getPackage();
+    
+    // Wait on the INT pin instead of sleeping. On success the driver owns the source; NULL reverts to sleeping.
+    bool setReadySource(ReadySource *source);
+    
+    // The ready source's descriptor, or -1 without one, for callers that wait out beginRead() on an
+    // event loop: once it is readable, endRead() completes the conversion without waiting out read.delay
+    int readyFd();
+    
+    // Threshold event mode: callback runs on the watcher thread whenever channel 0 leaves [low, high]
+    // for persistence consecutive periods. The window is then re-armed around the new reading.
+    bool startWatching(uint16_t low, uint16_t high, uint8_t persistence, std::function<void(const tsl2561Sample_t &)> callback);
+    void stopWatching();
+    bool isWatching();
+    
+    // History of completed samples. copyHistory() fills one caller array per field, oldest first,
+    // with timestamps in ms, gain as the multiplier and integration time in ms.
+    void setHistoryCapacity(size_t capacity);
+    size_t getHistorySize();
+    size_t copyHistory(size_t number, double *timestamp, uint16_t *broadband, uint16_t *ir, uint8_t *gain, uint16_t *integrationTime, uint32_t *lux);
+    
+    static uint16_t integrationMillis(tsl2561IntegrationTime_t time);
+    
+    // Nominal length of an ADC cycle, which is the sample period in continuous mode
+    static uint32_t integrationMicros(tsl2561IntegrationTime_t time);
+    
+    // Whether a value read from TSL2561_REGISTER_ID has the part number of a TSL2561
+    static bool isDeviceId(unsigned char id);
+    
+    // After threshold consecutive failed reads, reads fail at once with EHOSTDOWN while a background
+    // thread probes the sensor, starting every probeInterval ms. A threshold of 0 turns this off.
+    void setCircuitBreaker(uint32_t threshold, uint32_t probeInterval);
+    bool isCircuitOpen();
+    
+    // Counters and latencies since construction or the last reset, bus figures included
+    tsl2561Stats_t getStats();
+    void resetStats();
     
 protected:
     
     virtual bool initialize();
-    virtual std::string readValue0();
+    virtual deviceValue_t readValue0(const tsl2561Sample_t &sample);
+    virtual deviceValue_t readValue1(const tsl2561Sample_t &sample);
+    virtual deviceValue_t readValue2(const tsl2561Sample_t &sample);
+    virtual deviceValue_t readValue3(const tsl2561Sample_t &sample);
     
 private:
     
     // Create an array of read functions, so that multiple functions can be easily called
-    typedef std::string(Tsl2561Drv::*readValueType)();
-    readValueType readFunction[NUM_VALUES] = { &Tsl2561Drv::readValue0 };
+    typedef deviceValue_t(Tsl2561Drv::*readValueType)(const tsl2561Sample_t &sample);
+    readValueType readFunction[NUM_VALUES] = { &Tsl2561Drv::readValue0, &Tsl2561Drv::readValue1, &Tsl2561Drv::readValue2, &Tsl2561Drv::readValue3 };
     
-    void enable(void);
-    void disable(void);
-    void setIntegrationTime(tsl2561IntegrationTime_t time);
-    void setGain(tsl2561Gain_t gain);
-    void calcLuminosity ();
+    deviceValue_t readChannel(const tsl2561Sample_t &sample, uint8_t channel);
+    
+    int enable(void);
+    int disable(void);
+    int setTiming(tsl2561IntegrationTime_t time, tsl2561Gain_t gain);
+    int setInterruptControl(uint8_t value);
+    int writeShadowed(uint8_t reg, uint8_t value, uint8_t &shadow, uint8_t mask);
+    int predictRange();
+    bool applyPredictedRange();
+    bool readingInRange();
+    int calcLuminosity ();
+    int convert(int attempt);
+    bool rangeAgain(int attempt);
+    int advanceConversion(int &attempt);
     uint32_t calculateLux();
-    void getData ();
-    uint16_t read16(uint8_t reg);
+    int getData ();
+    int startConversion();
+    int readConversion();
+    int readChannels ();
+    void waitForConversion();
+    int clearInterrupt();
+    int setThresholds(uint16_t low, uint16_t high);
+    void watcherLoop();
+    uint32_t integrationDelay();
+    
+    void samplerLoop();
+    uint64_t nextPipelineRead(tsl2561Pacing_t &pacing);
+    bool freshReading(tsl2561Pacing_t &pacing);
+    tsl2561Sample_t storeSample(uint32_t lux);
+    int readSample(tsl2561Sample_t &sample, uint32_t maxAge);
+    int readable();
+    int countRead(int result, uint64_t start);
+    bool immediateSample(tsl2561Sample_t &sample, uint32_t maxAge, int &result);
+    bool claimConversion(std::unique_lock<std::mutex> &lock, uint64_t generation, tsl2561Sample_t &sample, int &result);
+    void publishConversion(const tsl2561Sample_t &sample, int result);
+    static uint32_t remainingMillis(uint64_t deadline);
+    bool latestSample(tsl2561Sample_t &sample);
+    bool cachedSample(tsl2561Sample_t &sample, uint32_t maxAge);
+    static uint64_t monotonicMicros();
     
-    int gainMult = 0;
-    bool autoGain = false;
-    tsl2561IntegrationTime_t integrationTime;
-    tsl2561Gain_t gain;
+    void recordOutcome(int result);
+    void proberLoop();
+    int probe();
+    void stopProbing();
+    
+    std::atomic<bool> autoGain{false};
+    bool ranged = false;
+    // Written by setTiming() under busLock, read without it by the getters and the sampler
+    std::atomic<tsl2561IntegrationTime_t> integrationTime{TSL2561_INTEGRATIONTIME_402MS};
+    std::atomic<tsl2561Gain_t> gain{TSL2561_GAIN_1X};
+    std::atomic<tsl2561Package_t> package{TSL2561_PACKAGE_T_FN_CL};
     
     uint16_t broadband, ir;
-
+    
+    ReadySource *readySource = NULL;
+    std::atomic<int> readyFile{-1};
+    
+    // Serializes bus access between the sampler thread and foreground reads
+    std::mutex busLock;
+    
+    // Single-flight state: callers arriving mid-conversion wait for its result. A conversion
+    // started by beginRead() stays open, without anyone converting, until its deadline (ns).
+    std::mutex conversionLock;
+    std::condition_variable conversionDone;
+    bool converting = false;
+    uint64_t conversionGeneration = 0;
+    tsl2561Sample_t lastConversion;
+    int lastConversionError = 0;
+    bool conversionOpen = false;
+    uint64_t conversionDeadline = 0;
+    int conversionAttempt = 0;
+    
+    // ADC cycles cut short so far by a power-down or a new timing, and the count when the
+    // current conversion started; under busLock
+    uint32_t powerCycles = 0;
+    uint32_t conversionCycles = 0;
+    uint64_t conversionStarted = 0;
+    
+    // What the sensor's registers hold, so that writing a value already there can be skipped. Only
+    // registers in shadowValid are trusted: each is dropped on a failed write, and all of them
+    // when the sensor goes away, as it may have lost power. Under busLock.
+    uint8_t shadowValid = 0;
+    uint8_t shadowControl = 0;
+    uint8_t shadowTiming = 0;
+    uint8_t shadowInterrupt = 0;
+    uint16_t shadowLow = 0;
+    uint16_t shadowHigh = 0;
+    
+    // Circuit breaker: opened by consecutive failures, closed again by the prober thread
+    std::atomic<uint32_t> breakerThreshold{TSL2561_BREAKER_THRESHOLD};
+    std::atomic<uint32_t> probeInterval{TSL2561_PROBE_INTERVAL_MS};
+    std::atomic<uint32_t> consecutiveFailures{0};
+    std::atomic<bool> circuitOpen{false};
+    std::thread prober;
+    std::mutex probeLock;
+    std::condition_variable probeWake;
+    bool probeStop = false;
+    
+    std::thread watcher;
+    std::atomic<bool> watching;
+    // The window as last armed, guarded by busLock once the watcher is running
+    uint16_t watchLow = 0;
+    uint16_t watchHigh = 0;
+    uint8_t watchPersistence = TSL2561_INTR_PERSIST_MIN;
+    std::function<void(const tsl2561Sample_t &)> watchCallback;
+    
+    std::thread sampler;
+    std::atomic<bool> running;
+    std::mutex samplerLock;
+    std::condition_variable samplerWake;
+    
+    // When the device was last powered up (ns); from then on it completes a conversion every period
+    std::atomic<uint64_t> poweredUp{0};
+    
+    // Completed samples, and the newest one in full
+    std::mutex historyLock;
+    std::condition_variable historyReady;
+    Tsl2561History history;
+    tsl2561Sample_t newest;
+    // When continuous mode last started, in µs on the monotonic clock
+    uint64_t samplerStart = 0;
+    
+    std::atomic<uint64_t> reads{0};
+    std::atomic<uint64_t> conversions{0};
+    std::atomic<uint64_t> cachedReads{0};
+    std::atomic<uint64_t> sharedReads{0};
+    std::atomic<uint64_t> rangeRetries{0};
+    std::atomic<uint64_t> failedReads{0};
+    std::atomic<uint64_t> rejectedReads{0};
+    std::atomic<uint64_t> breakerTrips{0};
+    std::atomic<uint64_t> skippedWrites{0};
+    LatencyHistogram readLatency;
+    LatencyHistogram conversionWait;
+    LatencyHistogram luxCalculation;
         
 };
 
@@ -0,0 +1,128 @@
+/**
+ * \file Tsl2561Group.cpp
+ *
+ *  Created on 10/16/2026.
+ *  Copyright (c) 2026 Agilatech. All rights reserved.
+ *
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "Tsl2561Group.h"
+#include "I2CBusExecutor.h"
+
+// Addresses selectable with the ADDR SEL pin
+static const uint32_t candidateAddresses[] = { TSL2561_ADDR_LOW, TSL2561_ADDR_FLOAT, TSL2561_ADDR_HIGH };
+
+Tsl2561Group::Tsl2561Group() {
+}
+
+/**
+ * @param driver a sensor to read along with the others, which must outlive the group
+ */
+void Tsl2561Group::add(Tsl2561Drv *driver) {
+    members.push_back(driver);
+}
+
+size_t Tsl2561Group::size() {
+    return members.size();
+}
+
+/**
+ * Power up every member and start its conversion. Members in continuous mode, or with a sample
+ * younger than maxAge, are done at once.
+ * @param read receives a sample and result per member
+ * @param maxAge in ms, as for Tsl2561Drv::getSample()
+ * @return the ms to wait before calling endRead(), or 0 if every member is done
+ */
+uint32_t Tsl2561Group::beginRead(tsl2561GroupRead_t &read, uint32_t maxAge) {
+    
+    read.samples.resize(members.size());
+    read.results.resize(members.size());
+    read.reads.resize(members.size());
+    
+    uint32_t delay = 0;
+    
+    for (size_t i = 0; i < members.size(); i++) {
+        read.results[i] = members[i]->beginRead(read.samples[i], maxAge, read.reads[i]);
+        
+        if (read.results[i] == TSL2561_READ_PENDING) {
+            delay = std::max(delay, read.reads[i].delay);
+        }
+    }
+    
+    return delay;
+}
+
+/**
+ * Read back every member still converting, one after the other. A member that auto-ranged
+ * into another conversion stays pending.
+ * @param read as filled in by beginRead()
+ * @return the ms to wait before calling endRead() again, or 0 if every member is done
+ */
+uint32_t Tsl2561Group::endRead(tsl2561GroupRead_t &read) {
+    
+    uint32_t delay = 0;
+    
+    for (size_t i = 0; i < members.size(); i++) {
+        if (read.results[i] != TSL2561_READ_PENDING) {
+            continue;
+        }
+        
+        read.results[i] = members[i]->endRead(read.samples[i], read.reads[i]);
+        
+        if (read.results[i] == TSL2561_READ_PENDING) {
+            delay = std::max(delay, read.reads[i].delay);
+        }
+    }
+    
+    return delay;
+}
+
+/**
+ * @param read receives a sample and result per member
+ * @param maxAge in ms, as for Tsl2561Drv::getSample()
+ */
+void Tsl2561Group::read(tsl2561GroupRead_t &read, uint32_t maxAge) {
+    
+    uint32_t delay = beginRead(read, maxAge);
+    
+    while (delay > 0) {
+        usleep(delay * 1000);
+        delay = endRead(read);
+    }
+}
+
+/**
+ * Probe the ID register at each address a TSL2561 can be strapped to. Absent addresses are not
+ * retried, so this costs one transaction per candidate. The probes go through the bus thread, so
+ * they are serialized with the transactions of sensors already open on the bus.
+ * @param devfile the bus, such as /dev/i2c-1
+ * @return the addresses that answered as a TSL2561, lowest first
+ */
+std::vector<uint32_t> Tsl2561Group::discover(std::string devfile) {
+    
+    std::vector<uint32_t> found;
+    // Hold the bus for the whole scan, so it is not reopened for every candidate
+    i2cbus::I2CBusExecutor *bus = i2cbus::I2CBusExecutor::acquire(devfile);
+    
+    for (size_t i = 0; i < sizeof(candidateAddresses) / sizeof(candidateAddresses[0]); i++) {
+        i2cbus::I2CBusTransport transport;
+        i2cbus::I2CDevice device(devfile, candidateAddresses[i], &transport);
+        unsigned char id;
+        
+        device.setRetry(0, 0);
+        
+        if (!device.readRegister(TSL2561_COMMAND_BIT | TSL2561_REGISTER_ID, id) && Tsl2561Drv::isDeviceId(id)) {
+            found.push_back(candidateAddresses[i]);
+        }
+    }
+    
+    i2cbus::I2CBusExecutor::release(bus);
+    return found;
+}
@@ -0,0 +1,62 @@
+/**
+ * \file Tsl2561Group.h
+ *
+ *  Created on 10/16/2026.
+ *  Copyright (c) 2026 Agilatech. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef __Tsl2561Group__
+#define __Tsl2561Group__
+
+#include <stdint.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "Tsl2561Drv.h"
+
+// Progress and results of a read across a group, one entry per member
+typedef struct
+{
+    std::vector<tsl2561Sample_t>  samples;
+    std::vector<int>              results;       // 0, a negative errno value, or TSL2561_READ_PENDING
+    std::vector<tsl2561Read_t>    reads;
+}
+tsl2561GroupRead_t;
+
+/**
+ * @class Tsl2561Group
+ * @brief Sensors read together: every member starts converting before any is waited for, so a
+ * snapshot of the whole group takes about one integration time rather than one per sensor
+ */
+class Tsl2561Group {
+    
+public:
+    Tsl2561Group();
+    
+    // Members are not owned, and must outlive the group
+    void add(Tsl2561Drv *driver);
+    size_t size();
+    
+    // Start every member, then finish the ones still converting. Both return the ms to wait
+    // before the next endRead(), or 0 once every member has a sample or an error.
+    uint32_t beginRead(tsl2561GroupRead_t &read, uint32_t maxAge = 0);
+    uint32_t endRead(tsl2561GroupRead_t &read);
+    
+    // The same, waiting on the calling thread
+    void read(tsl2561GroupRead_t &read, uint32_t maxAge = 0);
+    
+    // Addresses on the bus where a TSL2561 answers
+    static std::vector<uint32_t> discover(std::string devfile);
+    
+protected:
+    std::vector<Tsl2561Drv *> members;
+};
+
+#endif /* __Tsl2561Group__ */
@@ -0,0 +1,275 @@
+/**
+ * \file Tsl2561GroupNode.cpp
+ *
+ *  Created on 10/16/2026.
+ *  Copyright (c) 2026 Agilatech. All rights reserved.
+ *
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "Tsl2561GroupNode.h"
+
+namespace tsl2561 {
+    
+    using v8::FunctionCallbackInfo;
+    using v8::FunctionTemplate;
+    using v8::Function;
+    using v8::Persistent;
+    using v8::Isolate;
+    using v8::Context;
+    using v8::Local;
+    using v8::Handle;
+    using v8::Object;
+    using v8::String;
+    using v8::Value;
+    using v8::Number;
+    using v8::Array;
+    
+    Persistent<Function> Tsl2561GroupNode::constructor;
+    
+    void Tsl2561GroupNode::Init(Local<Object> exports) {
+        Isolate* isolate = exports->GetIsolate();
+        
+        // prep the constructor template
+        Local<FunctionTemplate> tpl = FunctionTemplate::New(isolate, New);
+        
+        // associates the New function with the class named Tsl2561Group
+        tpl->SetClassName(String::NewFromUtf8(isolate, "Tsl2561Group"));
+        
+        // InstanceTemplate is the ObjectTemplate assocated with the function New
+        tpl->InstanceTemplate()->SetInternalFieldCount(1);
+        
+        NODE_SET_PROTOTYPE_METHOD(tpl, "size", getSize);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "readAllSync", readAllSync);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "readAll", readAll);
+        
+        // store a reference to this constructor
+        constructor.Reset(isolate, tpl->GetFunction());
+        
+        exports->Set(String::NewFromUtf8(isolate, "Tsl2561Group"), tpl->GetFunction());
+        
+        // finding the sensors on a bus needs no group
+        NODE_SET_METHOD(exports, "discover", discover);
+    }
+    
+    void Tsl2561GroupNode::New(const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        
+        // if invoked as costructor: 'new Tsl2561Group([...])'
+        if (args.IsConstructCall()) {
+            
+            Tsl2561GroupNode* obj = new Tsl2561GroupNode();
+            Local<Array> members = Array::New(isolate);
+            
+            // anything that is not a Tsl2561 object is left out
+            if (args[0]->IsArray()) {
+                Local<Array> given = Local<Array>::Cast(args[0]);
+                Local<FunctionTemplate> member = Local<FunctionTemplate>::New(isolate, Tsl2561Node::classTemplate);
+                
+                for (uint32_t i = 0; i < given->Length(); i++) {
+                    Local<Value> value = given->Get(i);
+                    
+                    if (!member->HasInstance(value)) {
+                        continue;
+                    }
+                    
+                    Tsl2561Node *node = ObjectWrap::Unwrap<Tsl2561Node>(value->ToObject());
+                    
+                    obj->drivers.push_back(node->driver);
+                    obj->group.add(node->driver);
+                    members->Set(members->Length(), value);
+                }
+            }
+            
+            obj->members.Reset(isolate, members);
+            obj->Wrap(args.This());
+            
+            args.GetReturnValue().Set(args.This());
+        }
+        // else invoked as plain function 'Tsl2561Group(...)' -- turn into construct call
+        else {
+            const int argc = 1;
+            Local<Value> argv[argc] = { args[0] };
+            
+            Local<Function> cons = Local<Function>::New(isolate, constructor);
+            Local<Context> context = isolate->GetCurrentContext();
+            Local<Object> instance = cons->NewInstance(context, argc, argv).ToLocalChecked();
+            args.GetReturnValue().Set(instance);
+            
+        }
+        
+    }
+    
+    void Tsl2561GroupNode::getSize (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561GroupNode* obj = ObjectWrap::Unwrap<Tsl2561GroupNode>(args.Holder());
+        
+        args.GetReturnValue().Set(Number::New(isolate, obj->group.size()));
+    }
+    
+    void Tsl2561GroupNode::readAllSync (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561GroupNode* obj = ObjectWrap::Unwrap<Tsl2561GroupNode>(args.Holder());
+        
+        // optional first param is the max age in ms of a cached conversion that may be reused
+        uint32_t maxAge = args[0]->IsUndefined() ? 0 : args[0]->NumberValue();
+        
+        tsl2561GroupRead_t read;
+        obj->group.read(read, maxAge);
+        
+        args.GetReturnValue().Set(ValuesToV8(isolate, obj, read));
+    }
+    
+    void Tsl2561GroupNode::readAll (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        
+        Tsl2561GroupNode* obj = ObjectWrap::Unwrap<Tsl2561GroupNode>(args.Holder());
+        
+        Work * work = new Work();
+        work->request.data = work;
+        work->obj = obj;
+        work->timerStarted = false;
+        
+        // an optional max age in ms may come before the callback
+        int arg = 0;
+        work->maxAge = 0;
+        if (!args[arg]->IsFunction()) {
+            work->maxAge = args[arg++]->NumberValue();
+        }
+        
+        // store the callback from JS in the work package so we can invoke it later
+        Local<Function> callback = Local<Function>::Cast(args[arg]);
+        work->callback.Reset(isolate, callback);
+        
+        // keep the group, and with it the members, alive until the read is done
+        obj->Ref();
+        
+        uv_queue_work(uv_default_loop(), &work->request, WorkAsync, WorkAsyncComplete);
+        
+        args.GetReturnValue().Set(Undefined(isolate));
+    }
+    
+    void Tsl2561GroupNode::discover (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        
+        std::string devfile = "/dev/i2c-1";
+        if (!args[0]->IsUndefined()) {
+            String::Utf8Value param0(args[0]->ToString());
+            devfile = std::string(*param0);
+        }
+        
+        std::vector<uint32_t> found = Tsl2561Group::discover(devfile);
+        
+        Local<Array> addresses = Array::New(isolate, found.size());
+        for (size_t i = 0; i < found.size(); i++) {
+            addresses->Set(i, Number::New(isolate, found[i]));
+        }
+        
+        args.GetReturnValue().Set(addresses);
+    }
+    
+    // called by libuv worker in separate thread; starts every member converting
+    void Tsl2561GroupNode::WorkAsync(uv_work_t *req) {
+        Work *work = static_cast<Work *>(req->data);
+        
+        work->delay = work->obj->group.beginRead(work->read, work->maxAge);
+    }
+    
+    // called by libuv worker once the longest integration time has passed; reads them all back
+    void Tsl2561GroupNode::ReadoutAsync(uv_work_t *req) {
+        Work *work = static_cast<Work *>(req->data);
+        
+        work->delay = work->obj->group.endRead(work->read);
+    }
+    
+    // called by libuv on the event loop when the conversion time is up
+    void Tsl2561GroupNode::ReadoutTimer(uv_timer_t *handle) {
+        Work *work = static_cast<Work *>(handle->data);
+        
+        uv_queue_work(uv_default_loop(), &work->request, ReadoutAsync, WorkAsyncComplete);
+    }
+    
+    // once the timer handle is closed the request can be freed
+    void Tsl2561GroupNode::ReadoutTimerClosed(uv_handle_t *handle) {
+        delete static_cast<Work *>(handle->data);
+    }
+    
+    // called by libuv in event loop when either half of the read completes
+    void Tsl2561GroupNode::WorkAsyncComplete(uv_work_t *req, int status) {
+        Work *work = static_cast<Work *>(req->data);
+        
+        // some members are still integrating, so wait on the loop rather than on a threadpool thread
+        if (work->delay > 0) {
+            if (!work->timerStarted) {
+                uv_timer_init(uv_default_loop(), &work->timer);
+                work->timer.data = work;
+                work->timerStarted = true;
+            }
+            uv_timer_start(&work->timer, ReadoutTimer, work->delay, 0);
+            return;
+        }
+        
+        Isolate * isolate = Isolate::GetCurrent();
+        
+        v8::HandleScope handleScope(isolate);
+        
+        // set up return arguments: 0 = errors, 1 = values, one entry per member in each
+        Handle<Value> argv[] = { ErrorsToV8(isolate, work->read), ValuesToV8(isolate, work->obj, work->read) };
+        
+        Local<Function>::New(isolate, work->callback)->Call(isolate->GetCurrentContext()->Global(), 2, argv);
+        
+        // Free up the persistent function callback
+        work->callback.Reset();
+        
+        work->obj->Unref();
+        
+        if (work->timerStarted) {
+            uv_close(reinterpret_cast<uv_handle_t *>(&work->timer), ReadoutTimerClosed);
+        }
+        else {
+            delete work;
+        }
+    }
+    
+    // each member's values become an object keyed by value name, or null when its read failed
+    Local<Array> Tsl2561GroupNode::ValuesToV8(Isolate *isolate, Tsl2561GroupNode *obj, const tsl2561GroupRead_t &read) {
+        
+        Local<Array> result = Array::New(isolate, read.results.size());
+        
+        for (size_t i = 0; i < read.results.size(); i++) {
+            deviceValue_t values[Tsl2561Drv::NUM_VALUES];
+            bool valid = (read.results[i] == 0);
+            
+            if (valid) {
+                obj->drivers[i]->getValues(read.samples[i], values);
+            }
+            
+            result->Set(i, Tsl2561Node::ValuesToV8(isolate, obj->drivers[i], values, valid));
+        }
+        
+        return result;
+    }
+    
+    // null when every member was read, otherwise an Error or null per member
+    Local<Value> Tsl2561GroupNode::ErrorsToV8(Isolate *isolate, const tsl2561GroupRead_t &read) {
+        
+        if (std::find_if(read.results.begin(), read.results.end(), [](int result) { return result != 0; }) == read.results.end()) {
+            return Null(isolate);
+        }
+        
+        Local<Array> errors = Array::New(isolate, read.results.size());
+        
+        for (size_t i = 0; i < read.results.size(); i++) {
+            errors->Set(i, read.results[i] ? Tsl2561Node::ErrorToV8(isolate, read.results[i]) : Local<Value>(Null(isolate)));
+        }
+        
+        return errors;
+    }
+    
+}  // namespace tsl2561
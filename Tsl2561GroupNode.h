@@ -0,0 +1,80 @@
+/**
+ * \file Tsl2561GroupNode.h
+ *
+ *  Created on 10/16/2026.
+ *  Copyright (c) 2026 Agilatech. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef __Tsl2561GroupNode__
+#define __Tsl2561GroupNode__
+
+#include <node.h>
+#include <node_object_wrap.h>
+#include <uv.h>
+#include <vector>
+#include "Tsl2561Group.h"
+#include "Tsl2561Node.h"
+
+namespace tsl2561 {
+    
+class Tsl2561GroupNode : public node::ObjectWrap {
+ 
+public:
+    static void Init(v8::Local<v8::Object> exports);
+    
+    static void getSize (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void readAllSync (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void readAll (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void discover (const v8::FunctionCallbackInfo<v8::Value>& args);
+    
+private:
+    
+    explicit Tsl2561GroupNode() {}
+    ~Tsl2561GroupNode() { members.Reset(); }
+    
+    static void New(const v8::FunctionCallbackInfo<v8::Value>& args);
+    
+    static void WorkAsync(uv_work_t *req);
+    static void ReadoutAsync(uv_work_t *req);
+    static void ReadoutTimer(uv_timer_t *handle);
+    static void ReadoutTimerClosed(uv_handle_t *handle);
+    static void WorkAsyncComplete(uv_work_t *req, int status);
+    
+    static v8::Local<v8::Array> ValuesToV8(v8::Isolate *isolate, Tsl2561GroupNode *obj, const tsl2561GroupRead_t &read);
+    static v8::Local<v8::Value> ErrorsToV8(v8::Isolate *isolate, const tsl2561GroupRead_t &read);
+    
+    static v8::Persistent<v8::Function> constructor;
+    
+    Tsl2561Group group;
+    
+    // the member objects, which are kept alive for as long as the group is
+    v8::Persistent<v8::Array> members;
+    std::vector<Tsl2561Drv *> drivers;
+    
+    // a group read starts every member on a worker thread, waits on a timer on the event loop,
+    // and reads them all back on a worker thread
+    struct Work {
+        uv_work_t  request;
+        uv_timer_t timer;
+        bool timerStarted;
+        v8::Persistent<v8::Function> callback;
+        Tsl2561GroupNode *obj;
+        
+        uint32_t maxAge;
+        uint32_t delay;
+        tsl2561GroupRead_t read;
+    };
+    
+};
+    
+} // namespace
+
+
+#endif /* defined(__Tsl2561GroupNode__) */
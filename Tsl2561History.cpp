@@ -0,0 +1,114 @@
+/**
+ * \file Tsl2561History.cpp
+ *
+ *  Created on 10/16/2026.
+ *  Copyright (c) 2026 Agilatech. All rights reserved.
+ *
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "Tsl2561History.h"
+
+/**
+ * @param capacity the number of samples retained, at least 1
+ */
+Tsl2561History::Tsl2561History(size_t capacity) {
+    setCapacity(capacity);
+}
+
+/**
+ * Resize the ring. Samples already held are discarded.
+ * @param capacity the number of samples retained, at least 1
+ */
+void Tsl2561History::setCapacity(size_t capacity) {
+    if (capacity < 1) {
+        capacity = 1;
+    }
+    
+    timestamps.assign(capacity, 0);
+    broadbands.assign(capacity, 0);
+    irs.assign(capacity, 0);
+    gains.assign(capacity, 0);
+    integrationTimes.assign(capacity, 0);
+    luxes.assign(capacity, 0);
+    
+    head = 0;
+    count = 0;
+}
+
+size_t Tsl2561History::capacity() {
+    return timestamps.size();
+}
+
+size_t Tsl2561History::size() {
+    return count;
+}
+
+/**
+ * Add a sample, overwriting the oldest one once the ring is full.
+ */
+void Tsl2561History::push(double timestamp, uint16_t broadband, uint16_t ir, uint8_t gain, uint16_t integrationTime, uint32_t lux) {
+    timestamps[head] = timestamp;
+    broadbands[head] = broadband;
+    irs[head] = ir;
+    gains[head] = gain;
+    integrationTimes[head] = integrationTime;
+    luxes[head] = lux;
+    
+    head = (head + 1) % capacity();
+    if (count < capacity()) {
+        count++;
+    }
+}
+
+size_t Tsl2561History::indexOf(size_t age) {
+    return (head + capacity() - 1 - age) % capacity();
+}
+
+/**
+ * Copy the newest samples into caller arrays, oldest first. Each array must hold number elements.
+ * @param number the most samples to copy
+ * @return the number of samples actually copied, which is at most size()
+ */
+size_t Tsl2561History::copy(size_t number, double *timestamp, uint16_t *broadband, uint16_t *ir, uint8_t *gain, uint16_t *integrationTime, uint32_t *lux) {
+    if (number > count) {
+        number = count;
+    }
+    
+    if (number == 0) {
+        return 0;
+    }
+    
+    size_t first = indexOf(number - 1);
+    
+    copyField(timestamps, first, number, timestamp);
+    copyField(broadbands, first, number, broadband);
+    copyField(irs, first, number, ir);
+    copyField(gains, first, number, gain);
+    copyField(integrationTimes, first, number, integrationTime);
+    copyField(luxes, first, number, lux);
+    
+    return number;
+}
+
+/**
+ * The run of samples may wrap past the end of the ring, in which case it takes two copies.
+ */
+template <typename T>
+void Tsl2561History::copyField(const std::vector<T> &field, size_t first, size_t number, T *out) {
+    size_t tail = field.size() - first;
+    
+    if (number <= tail) {
+        memcpy(out, &field[first], number * sizeof(T));
+    }
+    else {
+        memcpy(out, &field[first], tail * sizeof(T));
+        memcpy(out + tail, &field[0], (number - tail) * sizeof(T));
+    }
+}
@@ -0,0 +1,58 @@
+/**
+ * \file Tsl2561History.h
+ *
+ *  Created on 10/16/2026.
+ *  Copyright (c) 2026 Agilatech. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef __Tsl2561History__
+#define __Tsl2561History__
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+/**
+ * @class Tsl2561History
+ * @brief Fixed-capacity ring of samples, kept as one array per field so a block of samples can be
+ * exported with a couple of memcpy calls per field instead of a copy per sample
+ */
+class Tsl2561History {
+    
+public:
+    Tsl2561History(size_t capacity);
+    
+    void setCapacity(size_t capacity);
+    size_t capacity();
+    size_t size();
+    
+    void push(double timestamp, uint16_t broadband, uint16_t ir, uint8_t gain, uint16_t integrationTime, uint32_t lux);
+    
+    size_t copy(size_t number, double *timestamp, uint16_t *broadband, uint16_t *ir, uint8_t *gain, uint16_t *integrationTime, uint32_t *lux);
+    
+protected:
+    size_t indexOf(size_t age);
+    
+    template <typename T>
+    void copyField(const std::vector<T> &field, size_t first, size_t number, T *out);
+    
+    std::vector<double> timestamps;         // ms, monotonic clock
+    std::vector<uint16_t> broadbands;
+    std::vector<uint16_t> irs;
+    std::vector<uint8_t> gains;             // gain multiplier, 1 or 16
+    std::vector<uint16_t> integrationTimes; // ms
+    std::vector<uint32_t> luxes;
+    
+    size_t head = 0;                        // slot the next sample goes into
+    size_t count = 0;
+};
+
+#endif /* __Tsl2561History__ */
@@ -0,0 +1,368 @@
+/**
+ * \file Tsl2561Lux.cpp
+ *
+ *  Created on 10/16/2026.
+ *  Copyright (c) 2026 Agilatech. All rights reserved.
+ *
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "Tsl2561Lux.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TSL2561_LUX_X86
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TSL2561_LUX_NEON
+#endif
+
+// C++11 still needs a definition for constexpr members that are used by address
+constexpr uint32_t Tsl2561LuxCoefficients<TSL2561_PACKAGE_T_FN_CL>::K[7];
+constexpr uint32_t Tsl2561LuxCoefficients<TSL2561_PACKAGE_T_FN_CL>::B[8];
+constexpr uint32_t Tsl2561LuxCoefficients<TSL2561_PACKAGE_T_FN_CL>::M[8];
+constexpr uint32_t Tsl2561LuxCoefficients<TSL2561_PACKAGE_CS>::K[7];
+constexpr uint32_t Tsl2561LuxCoefficients<TSL2561_PACKAGE_CS>::B[8];
+constexpr uint32_t Tsl2561LuxCoefficients<TSL2561_PACKAGE_CS>::M[8];
+
+// Row of the tables below for an integration time in ms. Anything unrecognised is taken as 402ms.
+static inline int timeIndex(uint16_t integrationTime) {
+    return (integrationTime == 13) ? 0 : ((integrationTime == 101) ? 1 : 2);
+}
+
+static constexpr uint32_t channelScale(int time, bool highGain) {
+    return ((time == 0) ? TSL2561_LUX_CHSCALE_TINT0 : ((time == 1) ? TSL2561_LUX_CHSCALE_TINT1 : (1 << TSL2561_LUX_CHSCALE))) << (highGain ? 0 : 4);
+}
+
+// Channel scale for each integration time, at 1x and 16x gain
+static constexpr uint32_t channelScales[3][2] = {
+    { channelScale(0, false), channelScale(0, true) },
+    { channelScale(1, false), channelScale(1, true) },
+    { channelScale(2, false), channelScale(2, true) }
+};
+
+// Saturation limit for each integration time
+static constexpr uint32_t clipThresholds[3] = { TSL2561_CLIPPING_13MS, TSL2561_CLIPPING_101MS, TSL2561_CLIPPING_402MS };
+
+template <tsl2561Package_t P>
+static uint32_t calculateOne(uint16_t broadband, uint16_t ir, uint8_t gain, uint16_t integrationTime) {
+    typedef Tsl2561LuxCoefficients<P> coefficients;
+    
+    int time = timeIndex(integrationTime);
+    
+    // Return max value lux if the sensor is saturated 
+    if ((broadband > clipThresholds[time]) || (ir > clipThresholds[time]))
+    {
+        return TSL2561_MAX_LUX;
+    }
+    
+    uint32_t chScale = channelScales[time][gain == 16];
+    
+    // Scale the channel values 
+    uint32_t channel0 = (broadband * chScale) >> TSL2561_LUX_CHSCALE;
+    uint32_t channel1 = (ir * chScale) >> TSL2561_LUX_CHSCALE;
+    
+    // Find the ratio of the channel values (Channel1/Channel0) 
+    uint32_t ratio1 = 0;
+    if (channel0 != 0) ratio1 = (channel1 << (TSL2561_LUX_RATIOSCALE+1)) / channel0;
+    
+    // round the ratio value 
+    uint32_t ratio = (ratio1 + 1) >> 1;
+    
+    // The breakpoints ascend, so the number of them below the ratio is its segment
+    uint32_t segment = 0;
+    for (int k = 0; k < 7; k++) {
+        segment += (ratio > coefficients::K[k]);
+    }
+    
+    uint32_t b = coefficients::B[segment];
+    uint32_t m = coefficients::M[segment];
+    
+    uint32_t temp;
+    
+    // Do not allow negative lux value 
+    if ((channel1 * m) > (channel0 * b)) {
+        temp = 0;
+    }
+    else {
+        temp = ((channel0 * b) - (channel1 * m));
+    }
+    
+    // Round lsb (2^(LUX_SCALE-1)) 
+    temp += (1 << (TSL2561_LUX_LUXSCALE-1));
+    
+    // Strip off fractional portion 
+    return temp >> TSL2561_LUX_LUXSCALE;
+}
+
+template <tsl2561Package_t P>
+static void calculateScalar(const uint16_t *broadband, const uint16_t *ir, const uint8_t *gain, const uint16_t *integrationTime, uint32_t *lux, size_t number) {
+    
+    for (size_t i = 0; i < number; i++) {
+        lux[i] = calculateOne<P>(broadband[i], ir[i], gain[i], integrationTime[i]);
+    }
+}
+
+// The vector versions avoid both the division and the segment lookup. With the rounding folded in,
+// ratio <= K holds exactly when (channel1 << 10) < (2K + 1) * channel0, and a zero channel0 always
+// falls in the first segment. Since the tests succeed for every breakpoint from the selected segment
+// upwards, b is the last segment's value plus the step (B[i] - B[i+1]) for each test that succeeds,
+// in modulo 2^32 arithmetic, and likewise for m. Every product stays within 32 bits for unclipped
+// input, and clipped lanes are overwritten at the end.
+
+#if defined(TSL2561_LUX_X86)
+
+template <tsl2561Package_t P>
+__attribute__((target("sse4.1")))
+static void calculateSse41(const uint16_t *broadband, const uint16_t *ir, const uint8_t *gain, const uint16_t *integrationTime, uint32_t *lux, size_t number) {
+    
+    // SSE only compares signed lanes, so unsigned compares are made with the sign bit flipped
+    const __m128i bias = _mm_set1_epi32((int)0x80000000);
+    const __m128i zero = _mm_setzero_si128();
+    
+    size_t i = 0;
+    
+    for (; i + 4 <= number; i += 4) {
+        int32_t gains;
+        memcpy(&gains, gain + i, sizeof(gains));
+        
+        __m128i ch0 = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(broadband + i)));
+        __m128i ch1 = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(ir + i)));
+        __m128i time = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(integrationTime + i)));
+        __m128i mult = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(gains));
+        
+        __m128i is13 = _mm_cmpeq_epi32(time, _mm_set1_epi32(13));
+        __m128i is101 = _mm_cmpeq_epi32(time, _mm_set1_epi32(101));
+        
+        __m128i clip = _mm_blendv_epi8(_mm_set1_epi32(clipThresholds[2]), _mm_set1_epi32(clipThresholds[1]), is101);
+        clip = _mm_blendv_epi8(clip, _mm_set1_epi32(clipThresholds[0]), is13);
+        __m128i clipped = _mm_or_si128(_mm_cmpgt_epi32(ch0, clip), _mm_cmpgt_epi32(ch1, clip));
+        
+        __m128i high = _mm_cmpeq_epi32(mult, _mm_set1_epi32(16));
+        __m128i scale13 = _mm_blendv_epi8(_mm_set1_epi32(channelScales[0][0]), _mm_set1_epi32(channelScales[0][1]), high);
+        __m128i scale101 = _mm_blendv_epi8(_mm_set1_epi32(channelScales[1][0]), _mm_set1_epi32(channelScales[1][1]), high);
+        __m128i scale = _mm_blendv_epi8(_mm_set1_epi32(channelScales[2][0]), _mm_set1_epi32(channelScales[2][1]), high);
+        scale = _mm_blendv_epi8(scale, scale101, is101);
+        scale = _mm_blendv_epi8(scale, scale13, is13);
+        
+        ch0 = _mm_srli_epi32(_mm_mullo_epi32(ch0, scale), TSL2561_LUX_CHSCALE);
+        ch1 = _mm_srli_epi32(_mm_mullo_epi32(ch1, scale), TSL2561_LUX_CHSCALE);
+        
+        __m128i scaled1 = _mm_xor_si128(_mm_slli_epi32(ch1, TSL2561_LUX_RATIOSCALE + 1), bias);
+        __m128i empty = _mm_cmpeq_epi32(ch0, zero);
+        
+        __m128i b = _mm_set1_epi32(Tsl2561LuxCoefficients<P>::B[7]);
+        __m128i m = _mm_set1_epi32(Tsl2561LuxCoefficients<P>::M[7]);
+        
+        for (int k = 0; k < 7; k++) {
+            __m128i bound = _mm_xor_si128(_mm_mullo_epi32(ch0, _mm_set1_epi32(2 * Tsl2561LuxCoefficients<P>::K[k] + 1)), bias);
+            __m128i below = _mm_or_si128(_mm_cmpgt_epi32(bound, scaled1), empty);
+            
+            b = _mm_add_epi32(b, _mm_and_si128(below, _mm_set1_epi32(Tsl2561LuxCoefficients<P>::B[k] - Tsl2561LuxCoefficients<P>::B[k + 1])));
+            m = _mm_add_epi32(m, _mm_and_si128(below, _mm_set1_epi32(Tsl2561LuxCoefficients<P>::M[k] - Tsl2561LuxCoefficients<P>::M[k + 1])));
+        }
+        
+        __m128i positive = _mm_mullo_epi32(ch0, b);
+        __m128i negative = _mm_mullo_epi32(ch1, m);
+        
+        // Do not allow negative lux value
+        __m128i temp = _mm_sub_epi32(_mm_max_epu32(positive, negative), negative);
+        temp = _mm_srli_epi32(_mm_add_epi32(temp, _mm_set1_epi32(1 << (TSL2561_LUX_LUXSCALE - 1))), TSL2561_LUX_LUXSCALE);
+        
+        temp = _mm_blendv_epi8(temp, _mm_set1_epi32(TSL2561_MAX_LUX), clipped);
+        
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(lux + i), temp);
+    }
+    
+    for (; i < number; i++) {
+        lux[i] = calculateOne<P>(broadband[i], ir[i], gain[i], integrationTime[i]);
+    }
+}
+
+template <tsl2561Package_t P>
+__attribute__((target("avx2")))
+static void calculateAvx2(const uint16_t *broadband, const uint16_t *ir, const uint8_t *gain, const uint16_t *integrationTime, uint32_t *lux, size_t number) {
+    
+    const __m256i bias = _mm256_set1_epi32((int)0x80000000);
+    const __m256i zero = _mm256_setzero_si256();
+    
+    size_t i = 0;
+    
+    for (; i + 8 <= number; i += 8) {
+        __m256i ch0 = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(broadband + i)));
+        __m256i ch1 = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(ir + i)));
+        __m256i time = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(integrationTime + i)));
+        __m256i mult = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(gain + i)));
+        
+        __m256i is13 = _mm256_cmpeq_epi32(time, _mm256_set1_epi32(13));
+        __m256i is101 = _mm256_cmpeq_epi32(time, _mm256_set1_epi32(101));
+        
+        __m256i clip = _mm256_blendv_epi8(_mm256_set1_epi32(clipThresholds[2]), _mm256_set1_epi32(clipThresholds[1]), is101);
+        clip = _mm256_blendv_epi8(clip, _mm256_set1_epi32(clipThresholds[0]), is13);
+        __m256i clipped = _mm256_or_si256(_mm256_cmpgt_epi32(ch0, clip), _mm256_cmpgt_epi32(ch1, clip));
+        
+        __m256i high = _mm256_cmpeq_epi32(mult, _mm256_set1_epi32(16));
+        __m256i scale13 = _mm256_blendv_epi8(_mm256_set1_epi32(channelScales[0][0]), _mm256_set1_epi32(channelScales[0][1]), high);
+        __m256i scale101 = _mm256_blendv_epi8(_mm256_set1_epi32(channelScales[1][0]), _mm256_set1_epi32(channelScales[1][1]), high);
+        __m256i scale = _mm256_blendv_epi8(_mm256_set1_epi32(channelScales[2][0]), _mm256_set1_epi32(channelScales[2][1]), high);
+        scale = _mm256_blendv_epi8(scale, scale101, is101);
+        scale = _mm256_blendv_epi8(scale, scale13, is13);
+        
+        ch0 = _mm256_srli_epi32(_mm256_mullo_epi32(ch0, scale), TSL2561_LUX_CHSCALE);
+        ch1 = _mm256_srli_epi32(_mm256_mullo_epi32(ch1, scale), TSL2561_LUX_CHSCALE);
+        
+        __m256i scaled1 = _mm256_xor_si256(_mm256_slli_epi32(ch1, TSL2561_LUX_RATIOSCALE + 1), bias);
+        __m256i empty = _mm256_cmpeq_epi32(ch0, zero);
+        
+        __m256i b = _mm256_set1_epi32(Tsl2561LuxCoefficients<P>::B[7]);
+        __m256i m = _mm256_set1_epi32(Tsl2561LuxCoefficients<P>::M[7]);
+        
+        for (int k = 0; k < 7; k++) {
+            __m256i bound = _mm256_xor_si256(_mm256_mullo_epi32(ch0, _mm256_set1_epi32(2 * Tsl2561LuxCoefficients<P>::K[k] + 1)), bias);
+            __m256i below = _mm256_or_si256(_mm256_cmpgt_epi32(bound, scaled1), empty);
+            
+            b = _mm256_add_epi32(b, _mm256_and_si256(below, _mm256_set1_epi32(Tsl2561LuxCoefficients<P>::B[k] - Tsl2561LuxCoefficients<P>::B[k + 1])));
+            m = _mm256_add_epi32(m, _mm256_and_si256(below, _mm256_set1_epi32(Tsl2561LuxCoefficients<P>::M[k] - Tsl2561LuxCoefficients<P>::M[k + 1])));
+        }
+        
+        __m256i positive = _mm256_mullo_epi32(ch0, b);
+        __m256i negative = _mm256_mullo_epi32(ch1, m);
+        
+        __m256i temp = _mm256_sub_epi32(_mm256_max_epu32(positive, negative), negative);
+        temp = _mm256_srli_epi32(_mm256_add_epi32(temp, _mm256_set1_epi32(1 << (TSL2561_LUX_LUXSCALE - 1))), TSL2561_LUX_LUXSCALE);
+        
+        temp = _mm256_blendv_epi8(temp, _mm256_set1_epi32(TSL2561_MAX_LUX), clipped);
+        
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(lux + i), temp);
+    }
+    
+    // The remainder is short enough for the 4 wide version to finish
+    calculateSse41<P>(broadband + i, ir + i, gain + i, integrationTime + i, lux + i, number - i);
+}
+
+#elif defined(TSL2561_LUX_NEON)
+
+template <tsl2561Package_t P>
+static void calculateNeon(const uint16_t *broadband, const uint16_t *ir, const uint8_t *gain, const uint16_t *integrationTime, uint32_t *lux, size_t number) {
+    
+    size_t i = 0;
+    
+    for (; i + 4 <= number; i += 4) {
+        uint32_t gains;
+        memcpy(&gains, gain + i, sizeof(gains));
+        
+        uint32x4_t ch0 = vmovl_u16(vld1_u16(broadband + i));
+        uint32x4_t ch1 = vmovl_u16(vld1_u16(ir + i));
+        uint32x4_t time = vmovl_u16(vld1_u16(integrationTime + i));
+        uint32x4_t mult = vmovl_u16(vget_low_u16(vmovl_u8(vcreate_u8(gains))));
+        
+        uint32x4_t is13 = vceqq_u32(time, vdupq_n_u32(13));
+        uint32x4_t is101 = vceqq_u32(time, vdupq_n_u32(101));
+        
+        uint32x4_t clip = vbslq_u32(is13, vdupq_n_u32(clipThresholds[0]), vbslq_u32(is101, vdupq_n_u32(clipThresholds[1]), vdupq_n_u32(clipThresholds[2])));
+        uint32x4_t clipped = vorrq_u32(vcgtq_u32(ch0, clip), vcgtq_u32(ch1, clip));
+        
+        uint32x4_t high = vceqq_u32(mult, vdupq_n_u32(16));
+        uint32x4_t scale = vbslq_u32(is13, vbslq_u32(high, vdupq_n_u32(channelScales[0][1]), vdupq_n_u32(channelScales[0][0])),
+                           vbslq_u32(is101, vbslq_u32(high, vdupq_n_u32(channelScales[1][1]), vdupq_n_u32(channelScales[1][0])),
+                                     vbslq_u32(high, vdupq_n_u32(channelScales[2][1]), vdupq_n_u32(channelScales[2][0]))));
+        
+        ch0 = vshrq_n_u32(vmulq_u32(ch0, scale), TSL2561_LUX_CHSCALE);
+        ch1 = vshrq_n_u32(vmulq_u32(ch1, scale), TSL2561_LUX_CHSCALE);
+        
+        uint32x4_t scaled1 = vshlq_n_u32(ch1, TSL2561_LUX_RATIOSCALE + 1);
+        uint32x4_t empty = vceqq_u32(ch0, vdupq_n_u32(0));
+        
+        uint32x4_t b = vdupq_n_u32(Tsl2561LuxCoefficients<P>::B[7]);
+        uint32x4_t m = vdupq_n_u32(Tsl2561LuxCoefficients<P>::M[7]);
+        
+        for (int k = 0; k < 7; k++) {
+            uint32x4_t below = vorrq_u32(vcltq_u32(scaled1, vmulq_n_u32(ch0, 2 * Tsl2561LuxCoefficients<P>::K[k] + 1)), empty);
+            
+            b = vaddq_u32(b, vandq_u32(below, vdupq_n_u32(Tsl2561LuxCoefficients<P>::B[k] - Tsl2561LuxCoefficients<P>::B[k + 1])));
+            m = vaddq_u32(m, vandq_u32(below, vdupq_n_u32(Tsl2561LuxCoefficients<P>::M[k] - Tsl2561LuxCoefficients<P>::M[k + 1])));
+        }
+        
+        uint32x4_t positive = vmulq_u32(ch0, b);
+        uint32x4_t negative = vmulq_u32(ch1, m);
+        
+        uint32x4_t temp = vsubq_u32(vmaxq_u32(positive, negative), negative);
+        temp = vshrq_n_u32(vaddq_u32(temp, vdupq_n_u32(1 << (TSL2561_LUX_LUXSCALE - 1))), TSL2561_LUX_LUXSCALE);
+        
+        vst1q_u32(lux + i, vbslq_u32(clipped, vdupq_n_u32(TSL2561_MAX_LUX), temp));
+    }
+    
+    for (; i < number; i++) {
+        lux[i] = calculateOne<P>(broadband[i], ir[i], gain[i], integrationTime[i]);
+    }
+}
+
+#endif
+
+Tsl2561Lux::batchTable_t Tsl2561Lux::selectBatch() {
+    
+#if defined(TSL2561_LUX_X86)
+    __builtin_cpu_init();
+    
+    if (__builtin_cpu_supports("avx2")) {
+        return { "avx2", { calculateAvx2<TSL2561_PACKAGE_T_FN_CL>, calculateAvx2<TSL2561_PACKAGE_CS> } };
+    }
+    
+    if (__builtin_cpu_supports("sse4.1")) {
+        return { "sse4.1", { calculateSse41<TSL2561_PACKAGE_T_FN_CL>, calculateSse41<TSL2561_PACKAGE_CS> } };
+    }
+#elif defined(TSL2561_LUX_NEON)
+    return { "neon", { calculateNeon<TSL2561_PACKAGE_T_FN_CL>, calculateNeon<TSL2561_PACKAGE_CS> } };
+#endif
+    
+    return { "scalar", { calculateScalar<TSL2561_PACKAGE_T_FN_CL>, calculateScalar<TSL2561_PACKAGE_CS> } };
+}
+
+const Tsl2561Lux::batchTable_t &Tsl2561Lux::batch() {
+    
+    // The CPU is only probed once, on first use
+    static const batchTable_t table = selectBatch();
+    
+    return table;
+}
+
+/**
+ * @param broadband raw channel 0 count
+ * @param ir raw channel 1 count
+ * @param gain gain multiplier, 16 for high gain and anything else for low gain
+ * @param integrationTime integration time in ms, 13 or 101, and anything else for 402
+ * @param package the sensor package, which selects the lux equation
+ * @return the lux value, or TSL2561_MAX_LUX if either channel is saturated
+ */
+uint32_t Tsl2561Lux::calculate(uint16_t broadband, uint16_t ir, uint8_t gain, uint16_t integrationTime, tsl2561Package_t package) {
+    
+    if (package == TSL2561_PACKAGE_CS) {
+        return calculateOne<TSL2561_PACKAGE_CS>(broadband, ir, gain, integrationTime);
+    }
+    
+    return calculateOne<TSL2561_PACKAGE_T_FN_CL>(broadband, ir, gain, integrationTime);
+}
+
+/**
+ * @param broadband raw channel 0 counts
+ * @param ir raw channel 1 counts
+ * @param gain gain multipliers
+ * @param integrationTime integration times in ms
+ * @param lux receives the lux values
+ * @param number the number of entries in each array
+ * @param package the sensor package, which selects the lux equation
+ */
+void Tsl2561Lux::calculate(const uint16_t *broadband, const uint16_t *ir, const uint8_t *gain, const uint16_t *integrationTime, uint32_t *lux, size_t number, tsl2561Package_t package) {
+    batch().functions[(package == TSL2561_PACKAGE_CS) ? TSL2561_PACKAGE_CS : TSL2561_PACKAGE_T_FN_CL](broadband, ir, gain, integrationTime, lux, number);
+}
+
+const char *Tsl2561Lux::implementation() {
+    return batch().name;
+}
@@ -0,0 +1,151 @@
+/**
+ * \file Tsl2561Lux.h
+ *
+ *  Created on 10/16/2026.
+ *  Copyright (c) 2026 Agilatech. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef __Tsl2561Lux__
+#define __Tsl2561Lux__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TSL2561_LUX_LUXSCALE      (14)      // Scale by 2^14
+#define TSL2561_LUX_RATIOSCALE    (9)       // Scale ratio by 2^9
+#define TSL2561_LUX_CHSCALE       (10)      // Scale channel values by 2^10
+#define TSL2561_LUX_CHSCALE_TINT0 (0x7517)  // 322/11 * 2^TSL2561_LUX_CHSCALE
+#define TSL2561_LUX_CHSCALE_TINT1 (0x0FE7)  // 322/81 * 2^TSL2561_LUX_CHSCALE
+
+// T, FN and CL package values
+#define TSL2561_LUX_K1T           (0x0040)  // 0.125 * 2^RATIO_SCALE
+#define TSL2561_LUX_B1T           (0x01f2)  // 0.0304 * 2^LUX_SCALE
+#define TSL2561_LUX_M1T           (0x01be)  // 0.0272 * 2^LUX_SCALE
+#define TSL2561_LUX_K2T           (0x0080)  // 0.250 * 2^RATIO_SCALE
+#define TSL2561_LUX_B2T           (0x0214)  // 0.0325 * 2^LUX_SCALE
+#define TSL2561_LUX_M2T           (0x02d1)  // 0.0440 * 2^LUX_SCALE
+#define TSL2561_LUX_K3T           (0x00c0)  // 0.375 * 2^RATIO_SCALE
+#define TSL2561_LUX_B3T           (0x023f)  // 0.0351 * 2^LUX_SCALE
+#define TSL2561_LUX_M3T           (0x037b)  // 0.0544 * 2^LUX_SCALE
+#define TSL2561_LUX_K4T           (0x0100)  // 0.50 * 2^RATIO_SCALE
+#define TSL2561_LUX_B4T           (0x0270)  // 0.0381 * 2^LUX_SCALE
+#define TSL2561_LUX_M4T           (0x03fe)  // 0.0624 * 2^LUX_SCALE
+#define TSL2561_LUX_K5T           (0x0138)  // 0.61 * 2^RATIO_SCALE
+#define TSL2561_LUX_B5T           (0x016f)  // 0.0224 * 2^LUX_SCALE
+#define TSL2561_LUX_M5T           (0x01fc)  // 0.0310 * 2^LUX_SCALE
+#define TSL2561_LUX_K6T           (0x019a)  // 0.80 * 2^RATIO_SCALE
+#define TSL2561_LUX_B6T           (0x00d2)  // 0.0128 * 2^LUX_SCALE
+#define TSL2561_LUX_M6T           (0x00fb)  // 0.0153 * 2^LUX_SCALE
+#define TSL2561_LUX_K7T           (0x029a)  // 1.3 * 2^RATIO_SCALE
+#define TSL2561_LUX_B7T           (0x0018)  // 0.00146 * 2^LUX_SCALE
+#define TSL2561_LUX_M7T           (0x0012)  // 0.00112 * 2^LUX_SCALE
+#define TSL2561_LUX_K8T           (0x029a)  // 1.3 * 2^RATIO_SCALE
+#define TSL2561_LUX_B8T           (0x0000)  // 0.000 * 2^LUX_SCALE
+#define TSL2561_LUX_M8T           (0x0000)  // 0.000 * 2^LUX_SCALE
+
+// CS package values
+#define TSL2561_LUX_K1C           (0x0043)  // 0.130 * 2^RATIO_SCALE
+#define TSL2561_LUX_B1C           (0x0204)  // 0.0315 * 2^LUX_SCALE
+#define TSL2561_LUX_M1C           (0x01ad)  // 0.0262 * 2^LUX_SCALE
+#define TSL2561_LUX_K2C           (0x0085)  // 0.260 * 2^RATIO_SCALE
+#define TSL2561_LUX_B2C           (0x0228)  // 0.0337 * 2^LUX_SCALE
+#define TSL2561_LUX_M2C           (0x02c1)  // 0.0430 * 2^LUX_SCALE
+#define TSL2561_LUX_K3C           (0x00c8)  // 0.390 * 2^RATIO_SCALE
+#define TSL2561_LUX_B3C           (0x0253)  // 0.0363 * 2^LUX_SCALE
+#define TSL2561_LUX_M3C           (0x0363)  // 0.0529 * 2^LUX_SCALE
+#define TSL2561_LUX_K4C           (0x010a)  // 0.520 * 2^RATIO_SCALE
+#define TSL2561_LUX_B4C           (0x0282)  // 0.0392 * 2^LUX_SCALE
+#define TSL2561_LUX_M4C           (0x03df)  // 0.0605 * 2^LUX_SCALE
+#define TSL2561_LUX_K5C           (0x014d)  // 0.65 * 2^RATIO_SCALE
+#define TSL2561_LUX_B5C           (0x0177)  // 0.0229 * 2^LUX_SCALE
+#define TSL2561_LUX_M5C           (0x01dd)  // 0.0291 * 2^LUX_SCALE
+#define TSL2561_LUX_K6C           (0x019a)  // 0.80 * 2^RATIO_SCALE
+#define TSL2561_LUX_B6C           (0x0101)  // 0.0157 * 2^LUX_SCALE
+#define TSL2561_LUX_M6C           (0x0127)  // 0.0180 * 2^LUX_SCALE
+#define TSL2561_LUX_K7C           (0x029a)  // 1.3 * 2^RATIO_SCALE
+#define TSL2561_LUX_B7C           (0x0037)  // 0.00338 * 2^LUX_SCALE
+#define TSL2561_LUX_M7C           (0x002b)  // 0.00260 * 2^LUX_SCALE
+#define TSL2561_LUX_K8C           (0x029a)  // 1.3 * 2^RATIO_SCALE
+#define TSL2561_LUX_B8C           (0x0000)  // 0.000 * 2^LUX_SCALE
+#define TSL2561_LUX_M8C           (0x0000)  // 0.000 * 2^LUX_SCALE
+
+// Clipping thresholds
+#define TSL2561_CLIPPING_13MS     (4900)
+#define TSL2561_CLIPPING_101MS    (37000)
+#define TSL2561_CLIPPING_402MS    (65000)
+
+#define TSL2561_MAX_LUX             21001
+
+// The lux equations differ between the chip-scale package and the others
+typedef enum
+{
+    TSL2561_PACKAGE_T_FN_CL           = 0,       // TMB, dual flat no-lead and ChipLED packages
+    TSL2561_PACKAGE_CS                = 1,       // Chipscale package
+    TSL2561_PACKAGE_COUNT
+}
+tsl2561Package_t;
+
+/**
+ * @struct Tsl2561LuxCoefficients
+ * @brief Ratio breakpoints and segment coefficients of a package's lux equation. Segment i applies
+ * when K[i-1] < ratio <= K[i]; the last segment has no breakpoint of its own.
+ */
+template <tsl2561Package_t P>
+struct Tsl2561LuxCoefficients;
+
+template <>
+struct Tsl2561LuxCoefficients<TSL2561_PACKAGE_T_FN_CL> {
+    static constexpr uint32_t K[7] = { TSL2561_LUX_K1T, TSL2561_LUX_K2T, TSL2561_LUX_K3T, TSL2561_LUX_K4T, TSL2561_LUX_K5T, TSL2561_LUX_K6T, TSL2561_LUX_K7T };
+    static constexpr uint32_t B[8] = { TSL2561_LUX_B1T, TSL2561_LUX_B2T, TSL2561_LUX_B3T, TSL2561_LUX_B4T, TSL2561_LUX_B5T, TSL2561_LUX_B6T, TSL2561_LUX_B7T, TSL2561_LUX_B8T };
+    static constexpr uint32_t M[8] = { TSL2561_LUX_M1T, TSL2561_LUX_M2T, TSL2561_LUX_M3T, TSL2561_LUX_M4T, TSL2561_LUX_M5T, TSL2561_LUX_M6T, TSL2561_LUX_M7T, TSL2561_LUX_M8T };
+};
+
+template <>
+struct Tsl2561LuxCoefficients<TSL2561_PACKAGE_CS> {
+    static constexpr uint32_t K[7] = { TSL2561_LUX_K1C, TSL2561_LUX_K2C, TSL2561_LUX_K3C, TSL2561_LUX_K4C, TSL2561_LUX_K5C, TSL2561_LUX_K6C, TSL2561_LUX_K7C };
+    static constexpr uint32_t B[8] = { TSL2561_LUX_B1C, TSL2561_LUX_B2C, TSL2561_LUX_B3C, TSL2561_LUX_B4C, TSL2561_LUX_B5C, TSL2561_LUX_B6C, TSL2561_LUX_B7C, TSL2561_LUX_B8C };
+    static constexpr uint32_t M[8] = { TSL2561_LUX_M1C, TSL2561_LUX_M2C, TSL2561_LUX_M3C, TSL2561_LUX_M4C, TSL2561_LUX_M5C, TSL2561_LUX_M6C, TSL2561_LUX_M7C, TSL2561_LUX_M8C };
+};
+
+/**
+ * @class Tsl2561Lux
+ * @brief Stateless lux calculation from raw channel counts, for one reading or for whole arrays of them.
+ * Gain is given as the multiplier (1 or 16) and integration time in ms (13, 101 or 402), the same
+ * encoding the sample history is exported in.
+ */
+class Tsl2561Lux {
+    
+public:
+    // The fixed-point calculation for one reading
+    static uint32_t calculate(uint16_t broadband, uint16_t ir, uint8_t gain, uint16_t integrationTime, tsl2561Package_t package = TSL2561_PACKAGE_T_FN_CL);
+    
+    // Fills lux[0..number) from the four input arrays, using the widest vector unit available.
+    // Results are identical to the single reading calculate() for every input.
+    static void calculate(const uint16_t *broadband, const uint16_t *ir, const uint8_t *gain, const uint16_t *integrationTime, uint32_t *lux, size_t number, tsl2561Package_t package = TSL2561_PACKAGE_T_FN_CL);
+    
+    // Name of the implementation the batch calculation dispatches to
+    static const char *implementation();
+    
+protected:
+    typedef void (*batchFunction_t)(const uint16_t *, const uint16_t *, const uint8_t *, const uint16_t *, uint32_t *, size_t);
+    
+    typedef struct
+    {
+        const char *name;
+        batchFunction_t functions[TSL2561_PACKAGE_COUNT];
+    }
+    batchTable_t;
+    
+    static batchTable_t selectBatch();
+    static const batchTable_t &batch();
+    
+};
+
+#endif /* __Tsl2561Lux__ */
@@ -13,6 +13,7 @@
  */
 
 #include "Tsl2561Node.h"
+#include "Tsl2561GroupNode.h"
 
 namespace tsl2561 {
     
@@ -29,9 +30,16 @@ namespace tsl2561 {
     using v8::Value;
     using v8::Number;
     using v8::Boolean;
+    using v8::Array;
+    using v8::ArrayBuffer;
+    using v8::Float64Array;
+    using v8::Uint32Array;
+    using v8::Uint16Array;
+    using v8::Uint8Array;
+    using v8::Exception;
     
     Persistent<Function> Tsl2561Node::constructor;
-    Tsl2561Drv* Tsl2561Node::driver = 0;
+    Persistent<FunctionTemplate> Tsl2561Node::classTemplate;
     
     void Tsl2561Node::Init(Local<Object> exports) {
         Isolate* isolate = exports->GetIsolate();
@@ -54,17 +62,49 @@ namespace tsl2561 {
         NODE_SET_PROTOTYPE_METHOD(tpl, "deviceActive", isDeviceActive);
         NODE_SET_PROTOTYPE_METHOD(tpl, "valueAtIndexSync", getValueAtIndexSync);
         NODE_SET_PROTOTYPE_METHOD(tpl, "valueAtIndex", getValueAtIndex);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "numberAtIndexSync", getNumberAtIndexSync);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "numberAtIndex", getNumberAtIndex);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "valuesAllSync", getValuesAllSync);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "valuesAll", getValuesAll);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "startContinuous", startContinuous);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "stopContinuous", stopContinuous);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "setInterruptLine", setInterruptLine);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "integrationTime", getIntegrationTime);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "setIntegrationTime", setIntegrationTime);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "gain", getGain);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "setGain", setGain);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "autoGain", getAutoGain);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "setAutoGain", setAutoGain);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "package", getPackage);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "setPackage", setPackage);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "watch", watch);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "unwatch", unwatch);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "stream", stream);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "stopStream", stopStream);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "history", getHistory);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "setHistoryCapacity", setHistoryCapacity);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "setSimulatedLight", setSimulatedLight);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "stats", getStats);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "resetStats", resetStats);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "setRetry", setRetry);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "setCircuitBreaker", setCircuitBreaker);
+        NODE_SET_PROTOTYPE_METHOD(tpl, "circuitOpen", isCircuitOpen);
 
         // store a reference to this constructor
         constructor.Reset(isolate, tpl->GetFunction());
+        classTemplate.Reset(isolate, tpl);
         
         exports->Set(String::NewFromUtf8(isolate, "Tsl2561"), tpl->GetFunction());
+        
+        // lux calculation over arrays of raw readings needs no device
+        NODE_SET_METHOD(exports, "calculateLux", calculateLux);
     }
     
     void Tsl2561Node::getDeviceName(const FunctionCallbackInfo<Value>& args) {
         Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
         
-        std::string name = driver->getDeviceName();
+        std::string name = obj->driver->getDeviceName();
         Local<String> deviceName = String::NewFromUtf8(isolate, name.c_str());
         
         args.GetReturnValue().Set(deviceName);
@@ -72,8 +112,9 @@ namespace tsl2561 {
     
     void Tsl2561Node::getDeviceType(const FunctionCallbackInfo<Value>& args) {
         Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
         
-        std::string type = driver->getDeviceType();
+        std::string type = obj->driver->getDeviceType();
         Local<String> deviceType = String::NewFromUtf8(isolate, type.c_str());
         
         args.GetReturnValue().Set(deviceType);
@@ -81,8 +122,9 @@ namespace tsl2561 {
     
     void Tsl2561Node::getDeviceVersion(const FunctionCallbackInfo<Value>& args) {
         Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
         
-        std::string ver = driver->getVersion();
+        std::string ver = obj->driver->getVersion();
         Local<String> deviceVer = String::NewFromUtf8(isolate, ver.c_str());
         
         args.GetReturnValue().Set(deviceVer);
@@ -90,8 +132,9 @@ namespace tsl2561 {
 
     void Tsl2561Node::getDeviceNumValues (const FunctionCallbackInfo<Value>& args) {
         Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
         
-        int value = driver->getNumValues();
+        int value = obj->driver->getNumValues();
         Local<Number> deviceNumVals = Number::New(isolate, value);
         
         args.GetReturnValue().Set(deviceNumVals);
@@ -99,8 +142,9 @@ namespace tsl2561 {
     
     void Tsl2561Node::getTypeAtIndex (const FunctionCallbackInfo<Value>& args) {
         Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
         
-        std::string type = driver->getTypeAtIndex(args[0]->NumberValue());
+        std::string type = obj->driver->getTypeAtIndex(args[0]->NumberValue());
         Local<String> valType = String::NewFromUtf8(isolate, type.c_str());
         
         args.GetReturnValue().Set(valType);
@@ -108,8 +152,9 @@ namespace tsl2561 {
     
     void Tsl2561Node::getNameAtIndex (const FunctionCallbackInfo<Value>& args) {
         Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
         
-        std::string name = driver->getNameAtIndex(args[0]->NumberValue());
+        std::string name = obj->driver->getNameAtIndex(args[0]->NumberValue());
         Local<String> valName = String::NewFromUtf8(isolate, name.c_str());
         
         args.GetReturnValue().Set(valName);
@@ -117,8 +162,9 @@ namespace tsl2561 {
     
     void Tsl2561Node::isDeviceActive (const FunctionCallbackInfo<Value>& args) {
         Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
         
-        bool active = driver->isActive();
+        bool active = obj->driver->isActive();
         Local<Boolean> deviceActive = Boolean::New(isolate, active);
         
         args.GetReturnValue().Set(deviceActive);
@@ -126,44 +172,712 @@ namespace tsl2561 {
     
     void Tsl2561Node::getValueAtIndexSync (const FunctionCallbackInfo<Value>& args) {
         Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        // optional second param is the max age in ms of a cached conversion that may be reused
+        uint32_t maxAge = args[1]->IsUndefined() ? 0 : args[1]->NumberValue();
         
-        std::string value = driver->getValueAtIndex(args[0]->NumberValue());
+        std::string value = obj->driver->getValueAtIndex(args[0]->NumberValue(), maxAge);
         Local<String> retValue = String::NewFromUtf8(isolate, value.c_str());
         
         args.GetReturnValue().Set(retValue);
     }
     
+    void Tsl2561Node::getNumberAtIndexSync (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        // optional second param is the max age in ms of a cached conversion that may be reused
+        uint32_t maxAge = args[1]->IsUndefined() ? 0 : args[1]->NumberValue();
+        
+        deviceValue_t value = obj->driver->getNumericValueAtIndex(args[0]->NumberValue(), maxAge);
+        
+        args.GetReturnValue().Set(NumberToV8(isolate, value));
+    }
+    
+    void Tsl2561Node::getValuesAllSync (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        // optional first param is the max age in ms of a cached conversion that may be reused
+        uint32_t maxAge = args[0]->IsUndefined() ? 0 : args[0]->NumberValue();
+        
+        deviceValue_t values[Tsl2561Drv::NUM_VALUES];
+        bool valid = obj->driver->getValuesAll(values, maxAge);
+        
+        args.GetReturnValue().Set(ValuesToV8(isolate, obj->driver, values, valid));
+    }
+    
     void Tsl2561Node::getValueAtIndex (const FunctionCallbackInfo<Value>& args) {
+        QueueRead(args, false, false);
+    }
+    
+    void Tsl2561Node::getNumberAtIndex (const FunctionCallbackInfo<Value>& args) {
+        QueueRead(args, true, false);
+    }
+    
+    void Tsl2561Node::getValuesAll (const FunctionCallbackInfo<Value>& args) {
+        QueueRead(args, true, true);
+    }
+    
+    void Tsl2561Node::QueueRead (const FunctionCallbackInfo<Value>& args, bool numeric, bool all) {
         Isolate* isolate = args.GetIsolate();
         
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
         Work * work = new Work();
         work->request.data = work;
+        work->obj = obj;
+        work->numeric = numeric;
+        work->queued = LatencyHistogram::now();
+        work->submitted = work->queued;
+        work->timerStarted = false;
         
-        // get the desired value index from the first param in the JS call
-        work->valueIndex = args[0]->NumberValue();
+        // get the desired value index from the first param in the JS call, unless all values are wanted
+        int arg = 0;
+        work->valueIndex = all ? VALUES_ALL : (int)args[arg++]->NumberValue();
+        
+        // an optional max age in ms may come before the callback
+        work->maxAge = 0;
+        if (!args[arg]->IsFunction()) {
+            work->maxAge = args[arg++]->NumberValue();
+        }
         
         // store the callback from JS in the work package so we can invoke it later
-        Local<Function> callback = Local<Function>::Cast(args[1]);
+        Local<Function> callback = Local<Function>::Cast(args[arg]);
         work->callback.Reset(isolate, callback);
         
-        // kick of the worker thread
+        // every value comes from the same conversion, so any read in flight can serve this one
+        if (obj->pending) {
+            obj->pending->waiters.push_back(work);
+            args.GetReturnValue().Set(Undefined(isolate));
+            return;
+        }
+        
+        // a request that may be served from the cache must not be joined by ones that may not
+        if (work->maxAge == 0) {
+            obj->pending = work;
+        }
+        
+        // keep the object alive until the worker is done with its driver
+        obj->Ref();
+        
+        // start the conversion on a worker thread; the wait happens on a timer, not on the thread
         uv_queue_work(uv_default_loop(),&work->request,WorkAsync,WorkAsyncComplete);
         
         args.GetReturnValue().Set(Undefined(isolate));
     }
     
-    void Tsl2561Node::New(const FunctionCallbackInfo<Value>& args) {
+    void Tsl2561Node::startContinuous (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        bool started = obj->driver->startContinuous();
+        Local<Boolean> retValue = Boolean::New(isolate, started);
+        
+        args.GetReturnValue().Set(retValue);
+    }
+    
+    void Tsl2561Node::stopContinuous (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        obj->driver->stopContinuous();
+        
+        args.GetReturnValue().Set(Undefined(isolate));
+    }
+    
+    void Tsl2561Node::setInterruptLine (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        bool success = false;
+        
+        // the driver closes the old descriptor, so stop polling it first
+        obj->CloseReady();
+        
+        // no arguments goes back to sleeping out the conversion time
+        if (args[0]->IsUndefined()) {
+            success = obj->driver->setReadySource(NULL);
+        }
+        else {
+            String::Utf8Value param0(args[0]->ToString());
+            std::string chipfile = std::string(*param0);
+            uint32_t line = args[1]->NumberValue();
+            
+            GpioReadySource *source = new GpioReadySource(chipfile, line);
+            
+            if (source->isOpen() && obj->driver->setReadySource(source)) {
+                success = true;
+            }
+            else {
+                delete source;
+            }
+        }
+        
+        args.GetReturnValue().Set(Boolean::New(isolate, success));
+    }
+    
+    void Tsl2561Node::getIntegrationTime (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        int ms = Tsl2561Drv::integrationMillis(obj->driver->getIntegrationTime());
+        
+        args.GetReturnValue().Set(Number::New(isolate, ms));
+    }
+    
+    void Tsl2561Node::setIntegrationTime (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        // integration time is given in ms, and must be one of 13, 101 or 402
+        bool success = true;
+        switch ((int)args[0]->NumberValue()) {
+            case 13: obj->driver->setIntegrationTime(TSL2561_INTEGRATIONTIME_13MS);
+                break;
+            case 101: obj->driver->setIntegrationTime(TSL2561_INTEGRATIONTIME_101MS);
+                break;
+            case 402: obj->driver->setIntegrationTime(TSL2561_INTEGRATIONTIME_402MS);
+                break;
+            default: success = false;
+        }
+        
+        args.GetReturnValue().Set(Boolean::New(isolate, success));
+    }
+    
+    void Tsl2561Node::getGain (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        int gain = (obj->driver->getGain() == TSL2561_GAIN_16X) ? 16 : 1;
+        
+        args.GetReturnValue().Set(Number::New(isolate, gain));
+    }
+    
+    void Tsl2561Node::setGain (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        // gain is given as the multiplier, either 1 or 16
+        bool success = true;
+        switch ((int)args[0]->NumberValue()) {
+            case 1: obj->driver->setGain(TSL2561_GAIN_1X);
+                break;
+            case 16: obj->driver->setGain(TSL2561_GAIN_16X);
+                break;
+            default: success = false;
+        }
+        
+        args.GetReturnValue().Set(Boolean::New(isolate, success));
+    }
+    
+    void Tsl2561Node::getAutoGain (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        bool autoGain = obj->driver->getAutoGain();
+        
+        args.GetReturnValue().Set(Boolean::New(isolate, autoGain));
+    }
+    
+    void Tsl2561Node::setAutoGain (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        obj->driver->setAutoGain(args[0]->BooleanValue());
+        
+        args.GetReturnValue().Set(Undefined(isolate));
+    }
+    
+    // Package names as printed in the datasheet. T, FN and CL share one lux equation.
+    static bool PackageFromV8(Local<Value> value, tsl2561Package_t &package) {
+        
+        if (!value->IsString()) {
+            return false;
+        }
+        
+        String::Utf8Value param(value);
+        std::string name(*param);
+        
+        if (name == "CS" || name == "cs") {
+            package = TSL2561_PACKAGE_CS;
+            return true;
+        }
+        
+        if (name == "T" || name == "t" || name == "FN" || name == "fn" || name == "CL" || name == "cl") {
+            package = TSL2561_PACKAGE_T_FN_CL;
+            return true;
+        }
+        
+        return false;
+    }
+    
+    void Tsl2561Node::getPackage (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        const char *name = (obj->driver->getPackage() == TSL2561_PACKAGE_CS) ? "CS" : "T";
+        
+        args.GetReturnValue().Set(String::NewFromUtf8(isolate, name));
+    }
+    
+    void Tsl2561Node::setPackage (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        tsl2561Package_t package;
+        bool success = (args.Length() > 0) && PackageFromV8(args[0], package);
+        
+        if (success) {
+            obj->driver->setPackage(package);
+        }
+        
+        args.GetReturnValue().Set(Boolean::New(isolate, success));
+    }
+    
+    void Tsl2561Node::watch (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        // params are the channel 0 window low and high, the persistence count, and the callback
+        if (obj->watcher || !args[3]->IsFunction()) {
+            args.GetReturnValue().Set(Boolean::New(isolate, false));
+            return;
+        }
+        
+        // the thresholds are 16 bit channel 0 counts and persistence is a 4 bit field, so anything
+        // outside those ranges would be truncated into a different window
+        double lowValue = args[0]->IsNumber() ? args[0]->NumberValue() : -1;
+        double highValue = args[1]->IsNumber() ? args[1]->NumberValue() : -1;
+        double persistenceValue = args[2]->IsUndefined() ? TSL2561_INTR_PERSIST_MIN : (args[2]->IsNumber() ? args[2]->NumberValue() : -1);
+        
+        if (!(lowValue >= 0 && lowValue <= 0xFFFF) || !(highValue >= 0 && highValue <= 0xFFFF) ||
+            !(persistenceValue >= TSL2561_INTR_PERSIST_ANY && persistenceValue <= TSL2561_INTR_PERSIST_MAX)) {
+            args.GetReturnValue().Set(Boolean::New(isolate, false));
+            return;
+        }
+        
+        uint16_t low = lowValue;
+        uint16_t high = highValue;
+        uint8_t persistence = persistenceValue;
+        
+        Watch *watcher = new Watch();
+        watcher->obj = obj;
+        watcher->async.data = watcher;
+        watcher->callback.Reset(isolate, Local<Function>::Cast(args[3]));
+        
+        uv_async_init(uv_default_loop(), &watcher->async, WatchAsync);
+        
+        bool started = obj->driver->startWatching(low, high, persistence, [watcher](const tsl2561Sample_t &sample) {
+            {
+                std::lock_guard<std::mutex> guard(watcher->lock);
+                watcher->events.push_back(sample);
+            }
+            uv_async_send(&watcher->async);
+        });
+        
+        if (!started) {
+            watcher->callback.Reset();
+            uv_close(reinterpret_cast<uv_handle_t *>(&watcher->async), WatchClosed);
+            args.GetReturnValue().Set(Boolean::New(isolate, false));
+            return;
+        }
+        
+        // keep the object alive for as long as events may arrive
+        obj->watcher = watcher;
+        obj->Ref();
+        
+        args.GetReturnValue().Set(Boolean::New(isolate, true));
+    }
+    
+    void Tsl2561Node::unwatch (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        if (obj->watcher) {
+            // once this returns, the driver will not queue any more events
+            obj->driver->stopWatching();
+            
+            obj->watcher->callback.Reset();
+            uv_close(reinterpret_cast<uv_handle_t *>(&obj->watcher->async), WatchClosed);
+            obj->watcher = NULL;
+            obj->Unref();
+        }
+        
+        args.GetReturnValue().Set(Undefined(isolate));
+    }
+    
+    void Tsl2561Node::stream (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        // params are the interval in ms, the callback, and an optional options object
+        if (obj->streamer || !args[1]->IsFunction() || !(args[0]->NumberValue() > 0)) {
+            args.GetReturnValue().Set(Boolean::New(isolate, false));
+            return;
+        }
+        
+        Stream *streamer = new Stream();
+        streamer->obj = obj;
+        streamer->async.data = streamer;
+        streamer->callback.Reset(isolate, Local<Function>::Cast(args[1]));
+        streamer->interval = args[0]->NumberValue();
+        streamer->capacity = STREAM_DEFAULT_CAPACITY;
+        streamer->overflow = STREAM_DROP_OLDEST;
+        streamer->dropped = 0;
+        streamer->error = 0;
+        streamer->running = true;
+        
+        if (args[2]->IsObject()) {
+            Local<Object> options = args[2]->ToObject();
+            
+            Local<Value> capacity = options->Get(String::NewFromUtf8(isolate, "capacity"));
+            if (capacity->IsNumber() && (capacity->NumberValue() >= 1)) {
+                streamer->capacity = capacity->NumberValue();
+            }
+            
+            Local<Value> overflow = options->Get(String::NewFromUtf8(isolate, "overflow"));
+            if (overflow->IsString()) {
+                String::Utf8Value policy(overflow);
+                if (std::string(*policy) == "drop-newest") {
+                    streamer->overflow = STREAM_DROP_NEWEST;
+                }
+                else if (std::string(*policy) == "block") {
+                    streamer->overflow = STREAM_BLOCK;
+                }
+            }
+        }
+        
+        uv_async_init(uv_default_loop(), &streamer->async, StreamAsync);
+        
+        streamer->thread = std::thread(StreamLoop, streamer);
+        
+        // keep the object alive for as long as samples may arrive
+        obj->streamer = streamer;
+        obj->Ref();
+        
+        args.GetReturnValue().Set(Boolean::New(isolate, true));
+    }
+    
+    void Tsl2561Node::stopStream (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        Stream *streamer = obj->streamer;
+        
+        if (streamer) {
+            {
+                std::lock_guard<std::mutex> guard(streamer->lock);
+                streamer->running = false;
+            }
+            
+            // wake the producer whether it is sleeping out the interval or blocked on a full queue
+            streamer->wake.notify_all();
+            streamer->space.notify_all();
+            streamer->thread.join();
+            
+            // samples still queued are dropped along with the handle
+            streamer->callback.Reset();
+            uv_close(reinterpret_cast<uv_handle_t *>(&streamer->async), StreamClosed);
+            obj->streamer = NULL;
+            obj->Unref();
+        }
+        
+        args.GetReturnValue().Set(Undefined(isolate));
+    }
+    
+    void Tsl2561Node::getHistory (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        // the optional argument limits the export to the newest n samples
+        size_t number = obj->driver->getHistorySize();
+        if (args.Length() > 0 && args[0]->IsNumber() && args[0]->NumberValue() >= 0) {
+            number = std::min(number, (size_t)args[0]->NumberValue());
+        }
+        
+        // One buffer holds every field, widest first so that each view stays aligned
+        size_t luxOffset = number * sizeof(double);
+        size_t broadbandOffset = luxOffset + number * sizeof(uint32_t);
+        size_t irOffset = broadbandOffset + number * sizeof(uint16_t);
+        size_t itimeOffset = irOffset + number * sizeof(uint16_t);
+        size_t gainOffset = itimeOffset + number * sizeof(uint16_t);
+        
+        Local<ArrayBuffer> buffer = ArrayBuffer::New(isolate, gainOffset + number * sizeof(uint8_t));
+        unsigned char *data = static_cast<unsigned char *>(buffer->GetContents().Data());
+        
+        // samples may have been added or the ring resized since the size was taken
+        number = obj->driver->copyHistory(number,
+                                          reinterpret_cast<double *>(data),
+                                          reinterpret_cast<uint16_t *>(data + broadbandOffset),
+                                          reinterpret_cast<uint16_t *>(data + irOffset),
+                                          reinterpret_cast<uint8_t *>(data + gainOffset),
+                                          reinterpret_cast<uint16_t *>(data + itimeOffset),
+                                          reinterpret_cast<uint32_t *>(data + luxOffset));
+        
+        Local<Object> history = Object::New(isolate);
+        history->Set(String::NewFromUtf8(isolate, "length"), Number::New(isolate, number));
+        history->Set(String::NewFromUtf8(isolate, "timestamp"), Float64Array::New(buffer, 0, number));
+        history->Set(String::NewFromUtf8(isolate, "lux"), Uint32Array::New(buffer, luxOffset, number));
+        history->Set(String::NewFromUtf8(isolate, "broadband"), Uint16Array::New(buffer, broadbandOffset, number));
+        history->Set(String::NewFromUtf8(isolate, "infrared"), Uint16Array::New(buffer, irOffset, number));
+        history->Set(String::NewFromUtf8(isolate, "integrationTime"), Uint16Array::New(buffer, itimeOffset, number));
+        history->Set(String::NewFromUtf8(isolate, "gain"), Uint8Array::New(buffer, gainOffset, number));
+        
+        args.GetReturnValue().Set(history);
+    }
+    
+    void Tsl2561Node::setHistoryCapacity (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        // resizing discards the samples currently held
+        bool success = false;
+        double capacity = (args.Length() > 0 && args[0]->IsNumber()) ? args[0]->NumberValue() : 0;
+        
+        // a capacity beyond the limit would allocate without bound, so it is an error rather than a refusal
+        if (capacity > TSL2561_HISTORY_MAX) {
+            isolate->ThrowException(Exception::RangeError(String::NewFromUtf8(isolate, "history capacity is limited to 1048576 samples")));
+            return;
+        }
+        
+        // NaN, fractions and anything below one are refused
+        if ((capacity >= 1) && (capacity == std::floor(capacity))) {
+            obj->driver->setHistoryCapacity((size_t)capacity);
+            success = true;
+        }
+        
+        args.GetReturnValue().Set(Boolean::New(isolate, success));
+    }
+    
+    void Tsl2561Node::getStats (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        tsl2561Stats_t stats = obj->driver->getStats();
+        
+        Local<Object> bus = Object::New(isolate);
+        bus->Set(String::NewFromUtf8(isolate, "transactions"), Number::New(isolate, stats.bus.transactions));
+        bus->Set(String::NewFromUtf8(isolate, "bytesRead"), Number::New(isolate, stats.bus.bytesRead));
+        bus->Set(String::NewFromUtf8(isolate, "bytesWritten"), Number::New(isolate, stats.bus.bytesWritten));
+        bus->Set(String::NewFromUtf8(isolate, "syscalls"), Number::New(isolate, stats.bus.syscalls));
+        bus->Set(String::NewFromUtf8(isolate, "errors"), Number::New(isolate, stats.bus.errors));
+        bus->Set(String::NewFromUtf8(isolate, "retries"), Number::New(isolate, stats.bus.retries));
+        
+        Local<Object> latency = Object::New(isolate);
+        latency->Set(String::NewFromUtf8(isolate, "bus"), HistogramToV8(isolate, stats.bus.latency));
+        latency->Set(String::NewFromUtf8(isolate, "conversionWait"), HistogramToV8(isolate, stats.conversionWait));
+        latency->Set(String::NewFromUtf8(isolate, "luxCalculation"), HistogramToV8(isolate, stats.luxCalculation));
+        latency->Set(String::NewFromUtf8(isolate, "read"), HistogramToV8(isolate, stats.read));
+        latency->Set(String::NewFromUtf8(isolate, "asyncQueue"), HistogramToV8(isolate, obj->asyncQueue.snapshot()));
+        latency->Set(String::NewFromUtf8(isolate, "asyncTotal"), HistogramToV8(isolate, obj->asyncTotal.snapshot()));
+        
+        Local<Object> result = Object::New(isolate);
+        result->Set(String::NewFromUtf8(isolate, "reads"), Number::New(isolate, stats.reads));
+        result->Set(String::NewFromUtf8(isolate, "conversions"), Number::New(isolate, stats.conversions));
+        result->Set(String::NewFromUtf8(isolate, "cachedReads"), Number::New(isolate, stats.cachedReads));
+        result->Set(String::NewFromUtf8(isolate, "sharedReads"), Number::New(isolate, stats.sharedReads));
+        result->Set(String::NewFromUtf8(isolate, "rangeRetries"), Number::New(isolate, stats.rangeRetries));
+        result->Set(String::NewFromUtf8(isolate, "failedReads"), Number::New(isolate, stats.failedReads));
+        result->Set(String::NewFromUtf8(isolate, "rejectedReads"), Number::New(isolate, stats.rejectedReads));
+        result->Set(String::NewFromUtf8(isolate, "breakerTrips"), Number::New(isolate, stats.breakerTrips));
+        result->Set(String::NewFromUtf8(isolate, "skippedWrites"), Number::New(isolate, stats.skippedWrites));
+        result->Set(String::NewFromUtf8(isolate, "bus"), bus);
+        result->Set(String::NewFromUtf8(isolate, "latency"), latency);
+        
+        args.GetReturnValue().Set(result);
+    }
+    
+    void Tsl2561Node::resetStats (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        obj->driver->resetStats();
+        obj->asyncQueue.reset();
+        obj->asyncTotal.reset();
+        
+        args.GetReturnValue().Set(Undefined(isolate));
+    }
+    
+    void Tsl2561Node::setRetry (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        // retries for a failed bus transaction, and the wait in µs before the first, doubling after
+        bool success = false;
+        if (args.Length() > 0 && args[0]->IsNumber() && args[0]->NumberValue() >= 0) {
+            uint32_t backoff = I2C_DEFAULT_BACKOFF_US;
+            if (args.Length() > 1 && args[1]->IsNumber() && args[1]->NumberValue() >= 0) {
+                backoff = args[1]->NumberValue();
+            }
+            obj->driver->setRetry(args[0]->NumberValue(), backoff);
+            success = true;
+        }
+        
+        args.GetReturnValue().Set(Boolean::New(isolate, success));
+    }
+    
+    void Tsl2561Node::setCircuitBreaker (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        // consecutive failures before reads fail fast, 0 to turn it off, and the first probe interval in ms
+        bool success = false;
+        if (args.Length() > 0 && args[0]->IsNumber() && args[0]->NumberValue() >= 0) {
+            uint32_t probeInterval = TSL2561_PROBE_INTERVAL_MS;
+            if (args.Length() > 1 && args[1]->IsNumber() && args[1]->NumberValue() >= 1) {
+                probeInterval = args[1]->NumberValue();
+            }
+            obj->driver->setCircuitBreaker(args[0]->NumberValue(), probeInterval);
+            success = true;
+        }
+        
+        args.GetReturnValue().Set(Boolean::New(isolate, success));
+    }
+    
+    void Tsl2561Node::isCircuitOpen (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        args.GetReturnValue().Set(Boolean::New(isolate, obj->driver->isCircuitOpen()));
+    }
+    
+    // Start of a typed array's elements within its buffer
+    template <typename T>
+    static T *TypedArrayData(Local<v8::TypedArray> array) {
+        return reinterpret_cast<T *>(static_cast<char *>(array->Buffer()->GetContents().Data()) + array->ByteOffset());
+    }
+    
+    void Tsl2561Node::calculateLux (const FunctionCallbackInfo<Value>& args) {
         Isolate* isolate = args.GetIsolate();
         
-        String::Utf8Value param0(args[0]->ToString());
-        std::string devfile = std::string(*param0);
+        // broadband, infrared and integrationTime are Uint16Arrays, gain a Uint8Array, all of equal
+        // length, laid out the way history() exports them. Optionally followed, in either order, by a
+        // Uint32Array to receive the result and the package name.
+        if (args.Length() < 4 || !args[0]->IsUint16Array() || !args[1]->IsUint16Array() || !args[2]->IsUint8Array() || !args[3]->IsUint16Array()) {
+            args.GetReturnValue().Set(Undefined(isolate));
+            return;
+        }
+        
+        Local<v8::TypedArray> broadband = Local<v8::TypedArray>::Cast(args[0]);
+        Local<v8::TypedArray> ir = Local<v8::TypedArray>::Cast(args[1]);
+        Local<v8::TypedArray> gain = Local<v8::TypedArray>::Cast(args[2]);
+        Local<v8::TypedArray> integrationTime = Local<v8::TypedArray>::Cast(args[3]);
         
-        uint32_t addr = args[1]->IsUndefined() ? 0x39 : args[1]->NumberValue();
+        size_t number = broadband->Length();
+        if (ir->Length() != number || gain->Length() != number || integrationTime->Length() != number) {
+            args.GetReturnValue().Set(Undefined(isolate));
+            return;
+        }
+        
+        Local<Uint32Array> lux;
+        tsl2561Package_t package = TSL2561_PACKAGE_T_FN_CL;
+        
+        for (int i = 4; i < args.Length(); i++) {
+            if (args[i]->IsUint32Array() && Local<Uint32Array>::Cast(args[i])->Length() >= number) {
+                lux = Local<Uint32Array>::Cast(args[i]);
+            }
+            else if (!PackageFromV8(args[i], package)) {
+                args.GetReturnValue().Set(Undefined(isolate));
+                return;
+            }
+        }
+        
+        if (lux.IsEmpty()) {
+            lux = Uint32Array::New(ArrayBuffer::New(isolate, number * sizeof(uint32_t)), 0, number);
+        }
+        
+        Tsl2561Lux::calculate(TypedArrayData<uint16_t>(broadband),
+                              TypedArrayData<uint16_t>(ir),
+                              TypedArrayData<uint8_t>(gain),
+                              TypedArrayData<uint16_t>(integrationTime),
+                              TypedArrayData<uint32_t>(lux),
+                              number,
+                              package);
+        
+        args.GetReturnValue().Set(lux);
+    }
+    
+    void Tsl2561Node::setSimulatedLight (const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
+        Tsl2561Node* obj = ObjectWrap::Unwrap<Tsl2561Node>(args.Holder());
+        
+        // only meaningful for an instance created with options.simulate
+        bool success = false;
+        if (obj->sim && args[0]->IsNumber() && args[1]->IsNumber()) {
+            obj->sim->setLight(args[0]->NumberValue(), args[1]->NumberValue());
+            success = true;
+        }
+        
+        args.GetReturnValue().Set(Boolean::New(isolate, success));
+    }
+    
+    // Builds a simulated sensor from { speed, latency, broadband, ir, script: [{ time, broadband, ir }], repeat }
+    Tsl2561Sim *Tsl2561Node::SimFromV8(Isolate *isolate, Local<Object> options, uint32_t addr) {
+        
+        Local<Value> speed = options->Get(String::NewFromUtf8(isolate, "speed"));
+        Tsl2561Sim *sim = new Tsl2561Sim(addr, speed->IsNumber() ? speed->NumberValue() : 1.0);
+        
+        Local<Value> latency = options->Get(String::NewFromUtf8(isolate, "latency"));
+        if (latency->IsNumber()) {
+            sim->setLatency(latency->NumberValue());
+        }
+        
+        Local<Value> broadband = options->Get(String::NewFromUtf8(isolate, "broadband"));
+        Local<Value> ir = options->Get(String::NewFromUtf8(isolate, "ir"));
+        sim->setLight(broadband->IsNumber() ? broadband->NumberValue() : 0, ir->IsNumber() ? ir->NumberValue() : 0);
+        
+        Local<Value> script = options->Get(String::NewFromUtf8(isolate, "script"));
+        if (script->IsArray()) {
+            Local<Array> points = Local<Array>::Cast(script);
+            std::vector<tsl2561SimPoint_t> steps;
+            
+            for (uint32_t i = 0; i < points->Length(); i++) {
+                Local<Value> entry = points->Get(i);
+                if (!entry->IsObject()) {
+                    continue;
+                }
+                
+                Local<Object> point = entry->ToObject();
+                tsl2561SimPoint_t step;
+                step.time = point->Get(String::NewFromUtf8(isolate, "time"))->NumberValue();
+                step.broadband = point->Get(String::NewFromUtf8(isolate, "broadband"))->NumberValue();
+                step.ir = point->Get(String::NewFromUtf8(isolate, "ir"))->NumberValue();
+                steps.push_back(step);
+            }
+            
+            sim->setScript(steps, options->Get(String::NewFromUtf8(isolate, "repeat"))->BooleanValue());
+        }
+        
+        return sim;
+    }
+    
+    void Tsl2561Node::New(const FunctionCallbackInfo<Value>& args) {
+        Isolate* isolate = args.GetIsolate();
         
         // if invoked as costructor: 'new Tsl2561(...)'
         if (args.IsConstructCall()) {
             
-            Tsl2561Node* obj = new Tsl2561Node();
+            std::string devfile = "/dev/i2c-1";
+            if (!args[0]->IsUndefined()) {
+                String::Utf8Value param0(args[0]->ToString());
+                devfile = std::string(*param0);
+            }
+            
+            uint32_t addr = args[1]->IsUndefined() ? 0x39 : args[1]->NumberValue();
+            
+            // options.simulate replaces the bus with an in-process sensor
+            Tsl2561Sim *sim = NULL;
+            if (args[2]->IsObject()) {
+                Local<Value> simulate = args[2]->ToObject()->Get(String::NewFromUtf8(isolate, "simulate"));
+                if (simulate->IsObject()) {
+                    sim = SimFromV8(isolate, simulate->ToObject(), addr);
+                }
+            }
+            
+            // every object owns its own driver, so one process can talk to many sensors
+            Tsl2561Node* obj = new Tsl2561Node(devfile, addr, sim);
             
             obj->Wrap(args.This());
             
@@ -171,8 +885,8 @@ namespace tsl2561 {
         }
         // else invoked as plain function 'Tsl2561(...)' -- turn into construct call
         else {
-            const int argc = 2;
-            Local<Value> argv[argc] = { args[0], args[1] };
+            const int argc = 3;
+            Local<Value> argv[argc] = { args[0], args[1], args[2] };
             
             Local<Function> cons = Local<Function>::New(isolate, constructor);
             Local<Context> context = isolate->GetCurrentContext();
@@ -181,46 +895,417 @@ namespace tsl2561 {
             
         }
         
-        if (!driver) {
-            driver = new Tsl2561Drv(devfile, addr);
-        }
-        
     }
     
-    // called by libuv worker in separate thread
+    // called by libuv worker in separate thread; powers the sensor up, which takes a bus write or two
     void Tsl2561Node::WorkAsync(uv_work_t *req) {
         Work *work = static_cast<Work *>(req->data);
+        
+        // how long the request sat in the uv queue before a thread picked it up
+        work->obj->asyncQueue.record(LatencyHistogram::now() - work->submitted);
+        
+        work->result = work->obj->driver->beginRead(work->sample, work->maxAge, work->read);
+    }
+    
+    // called by libuv worker once the integration time has passed; reads the channels back
+    void Tsl2561Node::ReadoutAsync(uv_work_t *req) {
+        Work *work = static_cast<Work *>(req->data);
+        
+        work->obj->asyncQueue.record(LatencyHistogram::now() - work->submitted);
+        
+        work->result = work->obj->driver->endRead(work->sample, work->read);
+    }
+    
+    // called by libuv on the event loop when the conversion time is up
+    void Tsl2561Node::ReadoutTimer(uv_timer_t *handle) {
+        QueueReadout(static_cast<Work *>(handle->data));
+    }
+    
+    // called by libuv on the event loop when INT signals the end of the conversion; every read
+    // waiting on this sensor goes back to the threadpool, and endRead() sorts out which one it was for
+    void Tsl2561Node::ReadoutReady(uv_poll_t *handle, int status, int events) {
+        Tsl2561Node *obj = static_cast<Tsl2561Node *>(handle->data);
+        
+        std::vector<Work *> waiters;
+        waiters.swap(obj->readyWaiters);
+        uv_poll_stop(handle);
+        
+        for (size_t i = 0; i < waiters.size(); i++) {
+            QueueReadout(waiters[i]);
+        }
+    }
+    
+    // whichever of INT and the timer comes first sends the read back to the threadpool
+    void Tsl2561Node::QueueReadout(Work *work) {
+        uv_timer_stop(&work->timer);
+        work->obj->StopWaitingReady(work);
+        
+        work->submitted = LatencyHistogram::now();
+        uv_queue_work(uv_default_loop(), &work->request, ReadoutAsync, WorkAsyncComplete);
+    }
+    
+    // the padded delay stays as the fallback when INT is wired
+    void Tsl2561Node::WaitReady(Work *work) {
+        int fd = this->driver->readyFd();
+        
+        if (fd < 0) {
+            return;
+        }
+        
+        // an idle handle left on a descriptor that has since been replaced is not reused
+        if (this->ready && (this->readyFile != fd) && this->readyWaiters.empty()) {
+            CloseReady();
+        }
+        
+        if (!this->ready) {
+            uv_poll_t *handle = new uv_poll_t;
+            if (uv_poll_init(uv_default_loop(), handle, fd) != 0) {
+                delete handle;
+                return;
+            }
+            handle->data = this;
+            this->ready = handle;
+            this->readyFile = fd;
+        }
+        
+        // the handle is busy on the old descriptor, so this read makes do with its timer
+        if (this->readyFile != fd) {
+            return;
+        }
+        
+        if (this->readyWaiters.empty()) {
+            uv_poll_start(this->ready, UV_READABLE, ReadoutReady);
+        }
+        this->readyWaiters.push_back(work);
+    }
+    
+    void Tsl2561Node::StopWaitingReady(Work *work) {
+        std::vector<Work *>::iterator found = std::find(this->readyWaiters.begin(), this->readyWaiters.end(), work);
+        
+        if (found == this->readyWaiters.end()) {
+            return;
+        }
+        
+        this->readyWaiters.erase(found);
+        
+        if (this->readyWaiters.empty()) {
+            uv_poll_stop(this->ready);
+        }
+    }
+    
+    // reads still waiting on INT are left to their timers
+    void Tsl2561Node::CloseReady() {
+        if (!this->ready) {
+            return;
+        }
+        
+        this->readyWaiters.clear();
+        uv_close(reinterpret_cast<uv_handle_t *>(this->ready), ReadyClosed);
+        this->ready = NULL;
+        this->readyFile = -1;
+    }
+    
+    void Tsl2561Node::ReadyClosed(uv_handle_t *handle) {
+        delete reinterpret_cast<uv_poll_t *>(handle);
+    }
     
-        work->value = driver->getValueAtIndex(work->valueIndex);
+    // once its timer is closed the request can be freed
+    void Tsl2561Node::ReadoutClosed(uv_handle_t *handle) {
+        delete static_cast<Work *>(handle->data);
     }
     
-    // called by libuv in event loop when async function completes
+    // called by libuv in event loop when either half of the read completes
     void Tsl2561Node::WorkAsyncComplete(uv_work_t *req, int status) {
+        Work *work = static_cast<Work *>(req->data);
+        
+        // the sensor is integrating, so wait on the loop rather than on a threadpool thread
+        if (work->result == TSL2561_READ_PENDING) {
+            if (!work->timerStarted) {
+                uv_timer_init(uv_default_loop(), &work->timer);
+                work->timer.data = work;
+                work->timerStarted = true;
+            }
+            uv_timer_start(&work->timer, ReadoutTimer, work->read.delay, 0);
+            work->obj->WaitReady(work);
+            return;
+        }
+        
         Isolate * isolate = Isolate::GetCurrent();
         
         v8::HandleScope handleScope(isolate);
         
-        Work *work = static_cast<Work *>(req->data);
+        work->valid = (work->result == 0);
+        work->error = work->result;
+        if (work->valid) {
+            work->obj->driver->getValues(work->sample, work->values);
+        }
         
-        // the work has been done, and now we store the value as a v8 string
+        // retire the request first, so callbacks that read again start a fresh conversion
+        if (work->obj->pending == work) {
+            work->obj->pending = NULL;
+        }
+        work->waiters.insert(work->waiters.begin(), work);
         
-        Local<String> retValue = String::NewFromUtf8(isolate, work->value.c_str());
+        deviceValue_t none = { DEVICE_VALUE_NONE, 0 };
         
-        // set up return arguments: 0 = error, 1 = returned value
-        Handle<Value> argv[] = { Null(isolate) , retValue };
+        // the work has been done, and now we store each value as a v8 string or number,
+        // depending on what each caller asked for
+        for (size_t i = 0; i < work->waiters.size(); i++) {
+            Work *waiter = work->waiters[i];
+            
+            Local<Value> retValue;
+            
+            if (waiter->valueIndex == VALUES_ALL) {
+                retValue = ValuesToV8(isolate, work->obj->driver, work->values, work->valid);
+            }
+            else {
+                bool inRange = work->valid && (waiter->valueIndex >= 0) && (waiter->valueIndex < Tsl2561Drv::NUM_VALUES);
+                const deviceValue_t &value = inRange ? work->values[waiter->valueIndex] : none;
+                
+                if (waiter->numeric) {
+                    retValue = NumberToV8(isolate, value);
+                }
+                else {
+                    retValue = String::NewFromUtf8(isolate, Device::valueToString(value).c_str());
+                }
+            }
+            
+            // set up return arguments: 0 = error, 1 = returned value
+            Handle<Value> argv[] = { work->valid ? Local<Value>(Null(isolate)) : ErrorToV8(isolate, work->error), retValue };
+            
+            work->obj->asyncTotal.record(LatencyHistogram::now() - waiter->queued);
+            
+            Local<Function>::New(isolate, work->waiters[i]->callback)->Call(isolate->GetCurrentContext()->Global(), 2, argv);
+            
+            // Free up the persistent function callback
+            work->waiters[i]->callback.Reset();
+        }
         
-        // execute the callback
-        Local<Function>::New(isolate, work->callback)->Call(isolate->GetCurrentContext()->Global(), 2, argv);
+        for (size_t i = 1; i < work->waiters.size(); i++) {
+            delete work->waiters[i];
+        }
         
-        // Free up the persistent function callback
-        work->callback.Reset();
-        delete work;
+        work->obj->Unref();
+        
+        if (work->timerStarted) {
+            uv_close(reinterpret_cast<uv_handle_t *>(&work->timer), ReadoutClosed);
+        }
+        else {
+            delete work;
+        }
         
     }
 
+    // numeric values become a JS Number, or null when no value is available
+    Local<Value> Tsl2561Node::NumberToV8(Isolate *isolate, const deviceValue_t &value) {
+        
+        switch (value.type) {
+            case DEVICE_VALUE_NONE:
+                return Null(isolate);
+            case DEVICE_VALUE_BOOLEAN:
+                return Boolean::New(isolate, value.number != 0);
+            default:
+                return Number::New(isolate, value.number);
+        }
+    }
+    
+    // all values become one object keyed by value name, or null when the read failed
+    Local<Value> Tsl2561Node::ValuesToV8(Isolate *isolate, Tsl2561Drv *driver, const deviceValue_t values[], bool valid) {
+        
+        if (!valid) {
+            return Null(isolate);
+        }
+        
+        Local<Object> result = Object::New(isolate);
+        
+        for (int i = 0; i < Tsl2561Drv::NUM_VALUES; i++) {
+            result->Set(String::NewFromUtf8(isolate, driver->getNameAtIndex(i).c_str()), NumberToV8(isolate, values[i]));
+        }
+        
+        return result;
+    }
+    
+    // a sample becomes an object with its values and a timestamp in ms
+    Local<Object> Tsl2561Node::SampleToV8(Isolate *isolate, const tsl2561Sample_t &sample) {
+        
+        Local<Object> result = Object::New(isolate);
+        result->Set(String::NewFromUtf8(isolate, "lux"), Number::New(isolate, sample.lux));
+        result->Set(String::NewFromUtf8(isolate, "broadband"), Number::New(isolate, sample.broadband));
+        result->Set(String::NewFromUtf8(isolate, "infrared"), Number::New(isolate, sample.ir));
+        result->Set(String::NewFromUtf8(isolate, "timestamp"), Number::New(isolate, sample.timestamp / 1000.0));
+        
+        return result;
+    }
+    
+    // a driver error becomes an Error with the errno name in code, as fs and net errors have
+    Local<Value> Tsl2561Node::ErrorToV8(Isolate *isolate, int error) {
+        
+        const char *message = NULL;
+        
+        switch (-error) {
+            case ENODEV:
+                message = "sensor did not initialize";
+                break;
+            case EHOSTDOWN:
+                message = "sensor is not responding, reads are suspended until it does";
+                break;
+            case ETIMEDOUT:
+                message = "no sample from continuous acquisition";
+                break;
+        }
+        
+        return node::ErrnoException(isolate, -error, NULL, message);
+    }
+    
+    // a latency histogram becomes its count and a few summary figures, all in microseconds
+    Local<Object> Tsl2561Node::HistogramToV8(Isolate *isolate, const histogramSnapshot_t &snapshot) {
+        
+        Local<Object> result = Object::New(isolate);
+        result->Set(String::NewFromUtf8(isolate, "count"), Number::New(isolate, snapshot.count));
+        result->Set(String::NewFromUtf8(isolate, "mean"), Number::New(isolate, snapshot.count ? (snapshot.sum / 1000.0 / snapshot.count) : 0));
+        result->Set(String::NewFromUtf8(isolate, "max"), Number::New(isolate, snapshot.max / 1000.0));
+        result->Set(String::NewFromUtf8(isolate, "p50"), Number::New(isolate, LatencyHistogram::percentile(snapshot, 0.50) / 1000.0));
+        result->Set(String::NewFromUtf8(isolate, "p90"), Number::New(isolate, LatencyHistogram::percentile(snapshot, 0.90) / 1000.0));
+        result->Set(String::NewFromUtf8(isolate, "p99"), Number::New(isolate, LatencyHistogram::percentile(snapshot, 0.99) / 1000.0));
+        
+        return result;
+    }
+    
+    // the stream's acquisition thread, which produces samples at a fixed cadence
+    void Tsl2561Node::StreamLoop(Stream *streamer) {
+        
+        std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+        
+        std::unique_lock<std::mutex> lock(streamer->lock);
+        
+        while (streamer->running) {
+            
+            tsl2561Sample_t sample;
+            int error;
+            
+            lock.unlock();
+            bool valid = streamer->obj->driver->getSample(sample, 0, &error);
+            lock.lock();
+            
+            if (!valid) {
+                // only the latest failure is kept until the event loop picks it up
+                streamer->error = error;
+                uv_async_send(&streamer->async);
+            }
+            else {
+                if (streamer->queue.size() >= streamer->capacity) {
+                    switch (streamer->overflow) {
+                        case STREAM_DROP_OLDEST:
+                            streamer->queue.pop_front();
+                            streamer->dropped++;
+                            break;
+                        case STREAM_DROP_NEWEST:
+                            streamer->dropped++;
+                            valid = false;
+                            break;
+                        default:
+                            streamer->space.wait(lock, [streamer] { return (streamer->queue.size() < streamer->capacity) || !streamer->running; });
+                            break;
+                    }
+                }
+                
+                if (valid && streamer->running) {
+                    streamer->queue.push_back(sample);
+                    
+                    // one wakeup may deliver many samples if the event loop is busy
+                    uv_async_send(&streamer->async);
+                }
+            }
+            
+            // keep to the cadence rather than drifting by the time each sample took, but after an
+            // overrun start again from now instead of firing back to back to catch up
+            next += std::chrono::milliseconds(streamer->interval);
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (next < now) {
+                next = now;
+            }
+            streamer->wake.wait_until(lock, next, [streamer] { return !streamer->running; });
+        }
+    }
+    
+    // called by libuv in event loop after the stream thread queued one or more samples
+    void Tsl2561Node::StreamAsync(uv_async_t *handle) {
+        Isolate * isolate = Isolate::GetCurrent();
+        
+        v8::HandleScope handleScope(isolate);
+        
+        Stream *streamer = static_cast<Stream *>(handle->data);
+        
+        std::deque<tsl2561Sample_t> samples;
+        uint64_t dropped;
+        int error;
+        {
+            std::lock_guard<std::mutex> guard(streamer->lock);
+            samples.swap(streamer->queue);
+            dropped = streamer->dropped;
+            streamer->dropped = 0;
+            error = streamer->error;
+            streamer->error = 0;
+        }
+        streamer->space.notify_all();
+        
+        if ((samples.empty() && !error) || streamer->callback.IsEmpty()) {
+            return;
+        }
+        
+        Local<Array> batch = Array::New(isolate, samples.size());
+        for (size_t i = 0; i < samples.size(); i++) {
+            batch->Set(i, SampleToV8(isolate, samples[i]));
+        }
+        
+        // set up return arguments: 0 = error, 1 = samples, 2 = samples dropped since the last batch
+        Handle<Value> argv[] = { error ? ErrorToV8(isolate, error) : Local<Value>(Null(isolate)), batch, Number::New(isolate, dropped) };
+        
+        Local<Function>::New(isolate, streamer->callback)->Call(isolate->GetCurrentContext()->Global(), 3, argv);
+    }
+    
+    // called by libuv once the async handle is closed and can be freed
+    void Tsl2561Node::StreamClosed(uv_handle_t *handle) {
+        delete static_cast<Stream *>(handle->data);
+    }
+    
+    // called by libuv in event loop after the watcher thread queued one or more events
+    void Tsl2561Node::WatchAsync(uv_async_t *handle) {
+        Isolate * isolate = Isolate::GetCurrent();
+        
+        v8::HandleScope handleScope(isolate);
+        
+        Watch *watcher = static_cast<Watch *>(handle->data);
+        
+        std::vector<tsl2561Sample_t> events;
+        {
+            std::lock_guard<std::mutex> guard(watcher->lock);
+            events.swap(watcher->events);
+        }
+        
+        for (size_t i = 0; i < events.size(); i++) {
+            
+            // unwatch() may have been called from an earlier callback
+            if (watcher->callback.IsEmpty()) {
+                break;
+            }
+            
+            // set up return arguments: 0 = error, 1 = event
+            Handle<Value> argv[] = { Null(isolate), SampleToV8(isolate, events[i]) };
+            
+            Local<Function>::New(isolate, watcher->callback)->Call(isolate->GetCurrentContext()->Global(), 2, argv);
+        }
+    }
+    
+    // called by libuv once the async handle is closed and can be freed
+    void Tsl2561Node::WatchClosed(uv_handle_t *handle) {
+        delete static_cast<Watch *>(handle->data);
+    }
+    
     void init(Local<Object> exports) {
         
         Tsl2561Node::Init(exports);
+        Tsl2561GroupNode::Init(exports);
         
     }
     
@@ -22,7 +22,15 @@
 #include <cmath>
 #include <string>
 #include <thread>
+#include <vector>
+#include <mutex>
+#include <deque>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include "Tsl2561Drv.h"
+#include "Tsl2561Sim.h"
+#include "I2CBusExecutor.h"
 
 namespace tsl2561 {
     
@@ -40,29 +48,183 @@ public:
     static void isDeviceActive (const v8::FunctionCallbackInfo<v8::Value>& args);
     static void getValueAtIndexSync (const v8::FunctionCallbackInfo<v8::Value>& args);
     static void getValueAtIndex (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void getNumberAtIndexSync (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void getNumberAtIndex (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void getValuesAllSync (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void getValuesAll (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void startContinuous (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void stopContinuous (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void setInterruptLine (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void getIntegrationTime (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void setIntegrationTime (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void getGain (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void setGain (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void getAutoGain (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void setAutoGain (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void getPackage (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void setPackage (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void watch (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void unwatch (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void stream (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void stopStream (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void getHistory (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void setHistoryCapacity (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void calculateLux (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void setSimulatedLight (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void getStats (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void resetStats (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void setRetry (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void setCircuitBreaker (const v8::FunctionCallbackInfo<v8::Value>& args);
+    static void isCircuitOpen (const v8::FunctionCallbackInfo<v8::Value>& args);
+    
+    // the constructor template, so that other classes can tell a Tsl2561 object apart
+    static v8::Persistent<v8::FunctionTemplate> classTemplate;
     
 private:
     
-    explicit Tsl2561Node(std::string devfile = "/dev/i2c-1", uint32_t addr = 0x39) {}
+    // the group reads its members' drivers directly
+    friend class Tsl2561GroupNode;
+    
+    // With a simulated sensor the node owns it, and the driver waits on its INT rather than sleeping.
+    // A real sensor goes through its bus's I/O thread, so sensors on separate buses read in parallel.
+    explicit Tsl2561Node(std::string devfile = "/dev/i2c-1", uint32_t addr = 0x39, Tsl2561Sim *sim = NULL) : sim(sim),
+        bus(sim ? NULL : new i2cbus::I2CBusTransport()),
+        driver(new Tsl2561Drv(devfile, addr, sim ? static_cast<i2cbus::I2CTransport *>(sim) : bus)) {
+        if (sim) {
+            driver->setReadySource(sim->interruptSource());
+        }
+    }
     
-    ~Tsl2561Node() {}
+    ~Tsl2561Node() { CloseReady(); delete driver; delete bus; delete sim; }
     
     static void New(const v8::FunctionCallbackInfo<v8::Value>& args);
     
+    static void QueueRead(const v8::FunctionCallbackInfo<v8::Value>& args, bool numeric, bool all);
+    static v8::Local<v8::Value> NumberToV8(v8::Isolate *isolate, const deviceValue_t &value);
+    static v8::Local<v8::Value> ValuesToV8(v8::Isolate *isolate, Tsl2561Drv *driver, const deviceValue_t values[], bool valid);
+    
     static void WorkAsync(uv_work_t *req);
+    static void ReadoutAsync(uv_work_t *req);
+    static void ReadoutTimer(uv_timer_t *handle);
+    static void ReadoutReady(uv_poll_t *handle, int status, int events);
+    static void ReadoutClosed(uv_handle_t *handle);
+    static void ReadyClosed(uv_handle_t *handle);
     static void WorkAsyncComplete(uv_work_t *req,int status);
     
+    static void WatchAsync(uv_async_t *handle);
+    static void WatchClosed(uv_handle_t *handle);
+    
+    static v8::Local<v8::Object> SampleToV8(v8::Isolate *isolate, const tsl2561Sample_t &sample);
+    static v8::Local<v8::Object> HistogramToV8(v8::Isolate *isolate, const histogramSnapshot_t &snapshot);
+    static v8::Local<v8::Value> ErrorToV8(v8::Isolate *isolate, int error);
+    static Tsl2561Sim *SimFromV8(v8::Isolate *isolate, v8::Local<v8::Object> options, uint32_t addr);
+    
     static v8::Persistent<v8::Function> constructor;
     
-    static Tsl2561Drv *driver;
+    Tsl2561Sim *sim;
+    i2cbus::I2CBusTransport *bus;
+    Tsl2561Drv *driver;
     
+    // an async read goes to the threadpool only for its bus transactions; the conversion
+    // time in between is waited out on the event loop, on INT where it is wired and otherwise
+    // on a timer
     struct Work {
         uv_work_t  request;
+        uv_timer_t timer;
+        bool timerStarted;
         v8::Persistent<v8::Function> callback;
+        Tsl2561Node *obj;
         
         int valueIndex;
-        std::string value;
+        uint32_t maxAge;
+        bool numeric;
+        
+        // progress through the driver's beginRead() and endRead()
+        tsl2561Read_t read;
+        tsl2561Sample_t sample;
+        int result;
+        
+        // when the request was made, and when it last went to the threadpool, for the async latencies
+        uint64_t queued;
+        uint64_t submitted;
+        
+        // every value is read from the one conversion, whichever index was asked for
+        bool valid;
+        int error;
+        deviceValue_t values[Tsl2561Drv::NUM_VALUES];
+        
+        // callers that arrived while this request was in flight share its result
+        std::vector<Work *> waiters;
+    };
+    
+    static void QueueReadout(Work *work);
+    
+    // INT is watched by one poll handle per sensor, however many reads wait on it, since libuv
+    // allows only one handle per descriptor. It runs while any read is waiting.
+    void WaitReady(Work *work);
+    void StopWaitingReady(Work *work);
+    void CloseReady();
+    
+    uv_poll_t *ready = NULL;
+    int readyFile = -1;
+    std::vector<Work *> readyWaiters;
+    
+    // value index used by requests for all values at once
+    static const int VALUES_ALL = -1;
+    
+    // the request in flight, touched only on the event loop thread
+    Work *pending = NULL;
+    
+    // time spent waiting for a threadpool thread, and from the request to its callback
+    LatencyHistogram asyncQueue;
+    LatencyHistogram asyncTotal;
+    
+    // threshold events are queued by the driver's watcher thread and drained on the event loop
+    struct Watch {
+        uv_async_t async;
+        v8::Persistent<v8::Function> callback;
+        Tsl2561Node *obj;
+        
+        std::mutex lock;
+        std::vector<tsl2561Sample_t> events;
     };
+    
+    Watch *watcher = NULL;
+    
+    // what the stream thread does when the event loop falls behind and the queue is full
+    enum StreamOverflow {
+        STREAM_DROP_OLDEST,
+        STREAM_DROP_NEWEST,
+        STREAM_BLOCK
+    };
+    
+    static const size_t STREAM_DEFAULT_CAPACITY = 256;
+    
+    // samples produced at a fixed cadence, and delivered to JS in batches on the event loop
+    struct Stream {
+        uv_async_t async;
+        v8::Persistent<v8::Function> callback;
+        Tsl2561Node *obj;
+        std::thread thread;
+        
+        uint32_t interval;
+        size_t capacity;
+        StreamOverflow overflow;
+        
+        std::mutex lock;
+        std::condition_variable wake;
+        std::condition_variable space;
+        std::deque<tsl2561Sample_t> queue;
+        uint64_t dropped;
+        int error;
+        bool running;
+    };
+    
+    static void StreamLoop(Stream *streamer);
+    static void StreamAsync(uv_async_t *handle);
+    static void StreamClosed(uv_handle_t *handle);
+    
+    Stream *streamer = NULL;
 
     
 };
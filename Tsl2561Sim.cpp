@@ -0,0 +1,434 @@
+/**
+ * \file Tsl2561Sim.cpp
+ *
+ *  Created on 10/16/2026.
+ *  Copyright (c) 2026 Agilatech. All rights reserved.
+ *
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "Tsl2561Sim.h"
+#include <string.h>
+#include <cmath>
+
+/**
+ * @param addr the bus address the simulated device answers on
+ * @param speed how many times faster than real time the simulated clock runs
+ */
+Tsl2561Sim::Tsl2561Sim(uint32_t addr, double speed) {
+    this->addr = addr;
+    this->speed = (speed > 0) ? speed : 1.0;
+    
+    powerOnReset();
+    
+    this->interruptFile = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    
+    this->epoch = std::chrono::steady_clock::now();
+    setLight(0, 0);
+    
+    this->converter = std::thread(&Tsl2561Sim::converterLoop, this);
+}
+
+Tsl2561Sim::~Tsl2561Sim() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        this->stopping = true;
+    }
+    changed.notify_all();
+    this->converter.join();
+    
+    if (this->interruptFile != -1) {
+        ::close(this->interruptFile);
+    }
+}
+
+int Tsl2561Sim::open(std::string, uint32_t addr) {
+    transaction();
+    
+    std::lock_guard<std::mutex> guard(lock);
+    
+    // Nothing acknowledges any other address
+    if (addr != this->addr) {
+        return -ENXIO;
+    }
+    
+    this->opened = true;
+    return 0;
+}
+
+unsigned long Tsl2561Sim::functionality() {
+    std::lock_guard<std::mutex> guard(lock);
+    return this->funcs;
+}
+
+ssize_t Tsl2561Sim::read(unsigned char *buffer, size_t length) {
+    transaction();
+    
+    std::lock_guard<std::mutex> guard(lock);
+    
+    if (!this->opened) {
+        return -EBADF;
+    }
+    
+    if (!this->present) {
+        return -ENXIO;
+    }
+    
+    readData(buffer, length);
+    return length;
+}
+
+ssize_t Tsl2561Sim::write(const unsigned char *buffer, size_t length) {
+    transaction();
+    
+    std::lock_guard<std::mutex> guard(lock);
+    
+    if (!this->opened) {
+        return -EBADF;
+    }
+    
+    if (!this->present) {
+        return -ENXIO;
+    }
+    
+    writeCommand(buffer, length);
+    return length;
+}
+
+int Tsl2561Sim::transfer(struct i2c_msg *messages, uint32_t number) {
+    transaction();
+    
+    std::lock_guard<std::mutex> guard(lock);
+    
+    if (!this->opened) {
+        return -EBADF;
+    }
+    
+    if (!(this->funcs & I2C_FUNC_I2C)) {
+        return -EOPNOTSUPP;
+    }
+    
+    if (!this->present) {
+        return -ENXIO;
+    }
+    
+    for (uint32_t i = 0; i < number; i++) {
+        if (messages[i].addr != this->addr) {
+            return -ENXIO;
+        }
+        
+        if (messages[i].flags & I2C_M_RD) {
+            readData(messages[i].buf, messages[i].len);
+        }
+        else {
+            writeCommand(messages[i].buf, messages[i].len);
+        }
+    }
+    
+    return 0;
+}
+
+void Tsl2561Sim::close() {
+    std::lock_guard<std::mutex> guard(lock);
+    this->opened = false;
+}
+
+void Tsl2561Sim::setLight(double broadband, double ir) {
+    tsl2561SimPoint_t point = { 0, broadband, ir };
+    setScript(std::vector<tsl2561SimPoint_t>(1, point), false);
+}
+
+/**
+ * @param script points in increasing time order
+ * @param repeat start over after the last point, rather than holding it
+ */
+void Tsl2561Sim::setScript(const std::vector<tsl2561SimPoint_t> &script, bool repeat) {
+    std::lock_guard<std::mutex> guard(lock);
+    
+    this->script = script;
+    this->repeat = repeat;
+    this->scriptStart = simulatedMicros(std::chrono::steady_clock::now());
+}
+
+void Tsl2561Sim::setLatency(uint32_t latencyUs) {
+    std::lock_guard<std::mutex> guard(lock);
+    this->latency = latencyUs;
+}
+
+void Tsl2561Sim::setFunctionality(unsigned long funcs) {
+    std::lock_guard<std::mutex> guard(lock);
+    this->funcs = funcs;
+}
+
+void Tsl2561Sim::setPresent(bool present) {
+    std::lock_guard<std::mutex> guard(lock);
+    
+    if (this->present && !present) {
+        powerOnReset();
+        
+        // Any conversion in progress is lost along with the power
+        this->generation++;
+        changed.notify_all();
+    }
+    
+    this->present = present;
+}
+
+ReadySource *Tsl2561Sim::interruptSource() {
+    return new FdReadySource(dup(this->interruptFile), true);
+}
+
+uint64_t Tsl2561Sim::getConversions() {
+    std::lock_guard<std::mutex> guard(lock);
+    return this->conversions;
+}
+
+uint64_t Tsl2561Sim::getTransactions() {
+    std::lock_guard<std::mutex> guard(lock);
+    return this->transactions;
+}
+
+// Hold the caller for the bus time of one transaction
+void Tsl2561Sim::transaction() {
+    uint32_t latency;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        this->transactions++;
+        latency = this->latency;
+    }
+    
+    if (latency) {
+        std::this_thread::sleep_for(std::chrono::microseconds(latency));
+    }
+}
+
+// The first byte is the command, which selects the register and can clear the interrupt. Any
+// further bytes are written from that register on. Without the command bit nothing happens.
+void Tsl2561Sim::writeCommand(const unsigned char *data, size_t length) {
+    
+    if ((length == 0) || !(data[0] & TSL2561_COMMAND_BIT)) {
+        return;
+    }
+    
+    this->pointer = data[0] & 0x0F;
+    
+    if (data[0] & TSL2561_CLEAR_BIT) {
+        setInterrupt(false);
+    }
+    
+    bool restart = false;
+    
+    for (size_t i = 1; i < length; i++) {
+        unsigned char reg = (this->pointer + i - 1) & 0x0F;
+        
+        switch (reg)
+        {
+            case TSL2561_REGISTER_CONTROL: {
+                bool power = ((data[i] & 0x03) == TSL2561_CONTROL_POWERON);
+                restart = restart || (power && !this->powered);
+                this->powered = power;
+                this->registers[reg] = data[i] & 0x03;
+                break;
+            }
+            case TSL2561_REGISTER_TIMING:
+                // A new integration time or gain starts the cycle over
+                restart = true;
+                this->registers[reg] = data[i];
+                break;
+            case TSL2561_REGISTER_INTERRUPT:
+                this->outside = 0;
+                this->registers[reg] = data[i];
+                break;
+            case TSL2561_REGISTER_ID:
+            case TSL2561_REGISTER_CHAN0_LOW:
+            case TSL2561_REGISTER_CHAN0_HIGH:
+            case TSL2561_REGISTER_CHAN1_LOW:
+            case TSL2561_REGISTER_CHAN1_HIGH:
+                // read only
+                break;
+            default:
+                this->registers[reg] = data[i];
+                break;
+        }
+    }
+    
+    if (restart || (length > 1 && !this->powered)) {
+        this->cycleStart = std::chrono::steady_clock::now();
+        this->generation++;
+        changed.notify_all();
+    }
+}
+
+// Reads continue through consecutive registers
+void Tsl2561Sim::readData(unsigned char *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        data[i] = this->registers[(this->pointer + i) & 0x0F];
+    }
+}
+
+void Tsl2561Sim::converterLoop() {
+    
+    std::unique_lock<std::mutex> guard(lock);
+    
+    while (!this->stopping) {
+        
+        if (!this->powered) {
+            changed.wait(guard);
+            continue;
+        }
+        
+        uint64_t generation = this->generation;
+        std::chrono::steady_clock::time_point end = this->cycleStart + std::chrono::microseconds((uint64_t)(cycleMicros() / this->speed));
+        
+        // Power, timing and shutdown changes all cut the cycle short
+        if (changed.wait_until(guard, end, [this, generation] { return this->stopping || (this->generation != generation); })) {
+            continue;
+        }
+        
+        this->cycleStart = end;
+        completeCycle();
+    }
+}
+
+// Latch the ADC channels at the end of an integration cycle, and update INT
+void Tsl2561Sim::completeCycle() {
+    
+    double broadband, ir;
+    lightAt(simulatedMicros(this->cycleStart), broadband, ir);
+    
+    unsigned char timing = this->registers[TSL2561_REGISTER_TIMING];
+    
+    // Response scales with the integration time, and low gain is 1/16 of high gain
+    double scale = (double)cycleMicros() / TSL2561_SIM_TIME_402MS;
+    if (!(timing & TSL2561_GAIN_16X)) {
+        scale /= 16;
+    }
+    
+    uint32_t channel0 = std::min<double>(broadband * scale, fullScale());
+    uint32_t channel1 = std::min<double>(ir * scale, fullScale());
+    
+    this->registers[TSL2561_REGISTER_CHAN0_LOW] = channel0 & 0xFF;
+    this->registers[TSL2561_REGISTER_CHAN0_HIGH] = channel0 >> 8;
+    this->registers[TSL2561_REGISTER_CHAN1_LOW] = channel1 & 0xFF;
+    this->registers[TSL2561_REGISTER_CHAN1_HIGH] = channel1 >> 8;
+    
+    this->conversions++;
+    
+    // INTR selects level interrupts; persistence 0 interrupts every cycle, and n after n cycles
+    // in a row with channel 0 outside the threshold window
+    unsigned char control = this->registers[TSL2561_REGISTER_INTERRUPT];
+    if ((control & 0x30) != TSL2561_INTR_LEVEL) {
+        return;
+    }
+    
+    uint32_t persistence = control & 0x0F;
+    if (persistence == TSL2561_INTR_PERSIST_ANY) {
+        setInterrupt(true);
+        return;
+    }
+    
+    uint16_t low = this->registers[TSL2561_REGISTER_THRESHHOLDL_LOW] | (this->registers[TSL2561_REGISTER_THRESHHOLDL_HIGH] << 8);
+    uint16_t high = this->registers[TSL2561_REGISTER_THRESHHOLDH_LOW] | (this->registers[TSL2561_REGISTER_THRESHHOLDH_HIGH] << 8);
+    
+    this->outside = ((channel0 < low) || (channel0 > high)) ? (this->outside + 1) : 0;
+    
+    if (this->outside >= persistence) {
+        setInterrupt(true);
+    }
+}
+
+// Registers as the device powers up: off, 402ms at 1x gain, no interrupt and an empty window
+void Tsl2561Sim::powerOnReset() {
+    
+    memset(this->registers, 0, sizeof(this->registers));
+    this->registers[TSL2561_REGISTER_ID] = TSL2561_SIM_ID;
+    this->registers[TSL2561_REGISTER_TIMING] = TSL2561_INTEGRATIONTIME_402MS;
+    
+    this->pointer = 0;
+    this->powered = false;
+    this->interrupt = false;
+    this->outside = 0;
+}
+
+// INT is active low and level triggered, so only a newly asserted interrupt makes an edge
+void Tsl2561Sim::setInterrupt(bool asserted) {
+    
+    if (asserted && !this->interrupt) {
+        uint64_t one = 1;
+        if (::write(this->interruptFile, &one, sizeof(one)) < 0) {
+            std::cerr << "Tsl2561Sim: Failed to signal INT" << std::endl;
+        }
+    }
+    
+    this->interrupt = asserted;
+}
+
+uint32_t Tsl2561Sim::cycleMicros() {
+    switch (this->registers[TSL2561_REGISTER_TIMING] & 0x03)
+    {
+        case TSL2561_INTEGRATIONTIME_13MS:
+            return TSL2561_SIM_TIME_13MS;
+        case TSL2561_INTEGRATIONTIME_101MS:
+            return TSL2561_SIM_TIME_101MS;
+        default:
+            return TSL2561_SIM_TIME_402MS;
+    }
+}
+
+uint32_t Tsl2561Sim::fullScale() {
+    switch (this->registers[TSL2561_REGISTER_TIMING] & 0x03)
+    {
+        case TSL2561_INTEGRATIONTIME_13MS:
+            return TSL2561_SIM_MAX_13MS;
+        case TSL2561_INTEGRATIONTIME_101MS:
+            return TSL2561_SIM_MAX_101MS;
+        default:
+            return TSL2561_SIM_MAX_402MS;
+    }
+}
+
+double Tsl2561Sim::simulatedMicros(std::chrono::steady_clock::time_point when) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(when - this->epoch).count() * this->speed;
+}
+
+void Tsl2561Sim::lightAt(double micros, double &broadband, double &ir) {
+    
+    if (this->script.empty()) {
+        broadband = ir = 0;
+        return;
+    }
+    
+    double ms = (micros - this->scriptStart) / 1000;
+    double length = this->script.back().time;
+    
+    if (this->repeat && (length > 0)) {
+        ms = std::fmod(ms, length);
+    }
+    
+    if (ms <= this->script.front().time) {
+        broadband = this->script.front().broadband;
+        ir = this->script.front().ir;
+        return;
+    }
+    
+    for (size_t i = 1; i < this->script.size(); i++) {
+        const tsl2561SimPoint_t &from = this->script[i - 1];
+        const tsl2561SimPoint_t &to = this->script[i];
+        
+        if (ms <= to.time) {
+            double fraction = (to.time > from.time) ? ((ms - from.time) / (to.time - from.time)) : 1.0;
+            broadband = from.broadband + fraction * (to.broadband - from.broadband);
+            ir = from.ir + fraction * (to.ir - from.ir);
+            return;
+        }
+    }
+    
+    broadband = this->script.back().broadband;
+    ir = this->script.back().ir;
+}
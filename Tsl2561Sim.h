@@ -0,0 +1,137 @@
+/**
+ * \file Tsl2561Sim.h
+ *
+ *  Created on 10/16/2026.
+ *  Copyright (c) 2026 Agilatech. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef __Tsl2561Sim__
+#define __Tsl2561Sim__
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <sys/eventfd.h>
+#include "Tsl2561Drv.h"
+
+// Value the ID register reads back: a TSL2561T, FN or CL at revision 0
+#define TSL2561_SIM_ID            (0x50)
+
+// Full-scale ADC counts for each integration time
+#define TSL2561_SIM_MAX_13MS      (5047)
+#define TSL2561_SIM_MAX_101MS     (37177)
+#define TSL2561_SIM_MAX_402MS     (65535)
+
+// Nominal integration times, in µs
+#define TSL2561_SIM_TIME_13MS     (13700)
+#define TSL2561_SIM_TIME_101MS    (101000)
+#define TSL2561_SIM_TIME_402MS    (402000)
+
+// One point of a light script. Between points the light changes linearly.
+typedef struct
+{
+    uint32_t  time;              // ms of simulated time from the start of the script
+    double    broadband;         // channel 0 response at 402ms and 16x gain, before saturation
+    double    ir;                // channel 1 response, on the same scale
+}
+tsl2561SimPoint_t;
+
+/**
+ * @class Tsl2561Sim
+ * @brief An in-process TSL2561 behind the I2C transport interface. It models the register file, power
+ * state, integration timing, gain, ADC saturation, the threshold interrupt and its persistence, and
+ * a scripted light level. Conversions complete on a thread of their own, in simulated time that runs
+ * at a chosen multiple of real time, and INT is reported through interruptSource().
+ */
+class Tsl2561Sim : public i2cbus::I2CTransport {
+    
+public:
+    Tsl2561Sim(uint32_t addr = TSL2561_ADDR_FLOAT, double speed = 1.0);
+    ~Tsl2561Sim();
+    
+    int open(std::string devfile, uint32_t addr);
+    unsigned long functionality();
+    ssize_t read(unsigned char *buffer, size_t length);
+    ssize_t write(const unsigned char *buffer, size_t length);
+    int transfer(struct i2c_msg *messages, uint32_t number);
+    void close();
+    
+    // Light level. A script starts at the current simulated time, and with repeat set starts over
+    // after its last point; otherwise the last point holds.
+    void setLight(double broadband, double ir);
+    void setScript(const std::vector<tsl2561SimPoint_t> &script, bool repeat);
+    
+    // Real time each bus transaction takes, and the adapter's reported I2C_FUNC_* flags
+    void setLatency(uint32_t latencyUs);
+    void setFunctionality(unsigned long funcs);
+    
+    // An absent device acknowledges nothing. Taking it away cuts its power, so it comes back in
+    // its power-on state, as a sensor does after being unplugged or browning out.
+    void setPresent(bool present);
+    
+    // A source following INT, for Tsl2561Drv::setReadySource(). All sources share the one line.
+    ReadySource *interruptSource();
+    
+    uint64_t getConversions();
+    uint64_t getTransactions();
+    
+protected:
+    void transaction();
+    void writeCommand(const unsigned char *data, size_t length);
+    void readData(unsigned char *data, size_t length);
+    
+    void converterLoop();
+    void completeCycle();
+    void setInterrupt(bool asserted);
+    void powerOnReset();
+    
+    uint32_t cycleMicros();
+    uint32_t fullScale();
+    double simulatedMicros(std::chrono::steady_clock::time_point when);
+    void lightAt(double micros, double &broadband, double &ir);
+    
+    uint32_t addr;
+    double speed;
+    unsigned long funcs = I2C_FUNC_I2C;
+    uint32_t latency = 0;
+    
+    // Guards everything below
+    std::mutex lock;
+    std::condition_variable changed;
+    
+    unsigned char registers[16];
+    unsigned char pointer = 0;
+    bool opened = false;
+    bool present = true;
+    
+    // The ADC cycle restarts whenever the generation changes
+    bool powered = false;
+    uint64_t generation = 0;
+    std::chrono::steady_clock::time_point cycleStart;
+    
+    bool interrupt = false;
+    uint32_t outside = 0;
+    int interruptFile;
+    
+    std::chrono::steady_clock::time_point epoch;
+    std::vector<tsl2561SimPoint_t> script;
+    double scriptStart = 0;
+    bool repeat = false;
+    
+    uint64_t conversions = 0;
+    uint64_t transactions = 0;
+    
+    bool stopping = false;
+    std::thread converter;
+};
+
+#endif /* __Tsl2561Sim__ */
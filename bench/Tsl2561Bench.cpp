@@ -0,0 +1,529 @@
+/**
+ * \file Tsl2561Bench.cpp
+ *
+ *  Created on 10/16/2026.
+ *  Copyright (c) 2026 Agilatech. All rights reserved.
+ *
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+// Microbenchmarks for the driver hot paths. The I2C bus is replaced by an in-process fake TSL2561:
+// open(), read(), write(), ioctl() and poll() are defined here, so the driver's calls on the fake
+// bus file are answered locally and everything else is passed on to the C library. Every call that
+// comes through them is counted, which gives the syscalls per operation the real bus would see.
+//
+// Usage: tsl2561_bench [--latency-us N] [--iterations N] [--rate-periods N] [--rate-speed X] [--no-rdwr] [--bus-thread] [--check-lux]
+//   --latency-us   time each bus transaction takes, spent spinning, default 0
+//   --iterations   operations per device benchmark, default 20000
+//   --rate-periods integration periods to time continuous mode over at each integration time, default
+//                  500 at 13.7 ms and 50 at the longer ones, 0 to skip
+//   --rate-speed   clock of the simulated sensor for the rate runs, as a multiple of nominal, default 1.0
+//   --no-rdwr      report an adapter without I2C_RDWR, so reads use the write and read fallback
+//   --bus-thread   run the bus transactions on a per-bus I/O thread, as the Node addon does
+//   --check-lux    instead of benchmarking, compare the batch lux calculation with the single reading
+//                  one for every input, and exit non-zero on any difference
+
+#include <dlfcn.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "../Tsl2561Drv.h"
+#include "../I2CBusExecutor.h"
+#include "../Tsl2561Sim.h"
+
+#define BENCH_BUS_FILE            "/dev/tsl2561-bench"
+#define BENCH_DEVICE_ADDR         (0x39)
+
+// Periods the rate runs cover by default. A run of only a few periods ends up measuring the wait for
+// the first sample and the scheduler, so the short integration time gets many more.
+#define BENCH_RATE_PERIODS_13MS   (500)
+#define BENCH_RATE_PERIODS        (50)
+
+static std::atomic<uint64_t> syscalls(0);
+
+// The fake device
+static int busFile = -1;
+static int readyFile = -1;
+static unsigned char registers[16];
+static unsigned char pointer = 0;
+static unsigned long busFuncs = I2C_FUNC_I2C;
+static uint64_t latencyNs = 0;
+
+template <typename F>
+static F realFunction(F &cached, const char *name) {
+    if (!cached) {
+        cached = reinterpret_cast<F>(dlsym(RTLD_NEXT, name));
+    }
+    return cached;
+}
+
+static void transaction() {
+    
+    if (latencyNs == 0) {
+        return;
+    }
+    
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::nanoseconds(latencyNs);
+    while (std::chrono::steady_clock::now() < end) {}
+}
+
+// A command byte selects the register; any bytes after it are written from there on
+static void deviceWrite(const unsigned char *data, size_t length) {
+    
+    if (length == 0) {
+        return;
+    }
+    
+    pointer = data[0] & 0x0F;
+    
+    for (size_t i = 1; i < length; i++) {
+        registers[(pointer + i - 1) & 0x0F] = data[i];
+    }
+    
+    // Powering up starts a conversion, which the fake completes at once and signals on INT
+    if ((length > 1) && (pointer == TSL2561_REGISTER_CONTROL) && ((data[1] & 0x03) == TSL2561_CONTROL_POWERON)) {
+        uint64_t one = 1;
+        if (::write(readyFile, &one, sizeof(one)) < 0) {
+            std::cerr << "Bench: Failed to signal INT" << std::endl;
+        }
+    }
+}
+
+static void deviceRead(unsigned char *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        data[i] = registers[(pointer + i) & 0x0F];
+    }
+}
+
+extern "C" {
+    
+    int open(const char *path, int flags, ...) {
+        static int (*real)(const char *, int, ...);
+        
+        mode_t mode = 0;
+        if (flags & O_CREAT) {
+            va_list args;
+            va_start(args, flags);
+            mode = va_arg(args, int);
+            va_end(args);
+        }
+        
+        syscalls++;
+        
+        if (strcmp(path, BENCH_BUS_FILE) == 0) {
+            busFile = realFunction(real, "open")("/dev/null", O_RDWR);
+            return busFile;
+        }
+        
+        return realFunction(real, "open")(path, flags, mode);
+    }
+    
+    int open64(const char *path, int flags, ...) {
+        mode_t mode = 0;
+        if (flags & O_CREAT) {
+            va_list args;
+            va_start(args, flags);
+            mode = va_arg(args, int);
+            va_end(args);
+        }
+        return open(path, flags, mode);
+    }
+    
+    ssize_t read(int fd, void *buffer, size_t count) {
+        static ssize_t (*real)(int, void *, size_t);
+        
+        syscalls++;
+        
+        if ((fd != -1) && (fd == busFile)) {
+            transaction();
+            deviceRead(static_cast<unsigned char *>(buffer), count);
+            return count;
+        }
+        
+        return realFunction(real, "read")(fd, buffer, count);
+    }
+    
+    ssize_t write(int fd, const void *buffer, size_t count) {
+        static ssize_t (*real)(int, const void *, size_t);
+        
+        if ((fd != -1) && (fd == busFile)) {
+            syscalls++;
+            transaction();
+            deviceWrite(static_cast<const unsigned char *>(buffer), count);
+            return count;
+        }
+        
+        // Signalling INT is part of the fake device, not a call the driver makes
+        return realFunction(real, "write")(fd, buffer, count);
+    }
+    
+    int ioctl(int fd, unsigned long request, ...) {
+        static int (*real)(int, unsigned long, ...);
+        
+        va_list args;
+        va_start(args, request);
+        void *argument = va_arg(args, void *);
+        va_end(args);
+        
+        syscalls++;
+        
+        if ((fd == -1) || (fd != busFile)) {
+            return realFunction(real, "ioctl")(fd, request, argument);
+        }
+        
+        switch (request) {
+            case I2C_SLAVE:
+                return ((unsigned long)argument == BENCH_DEVICE_ADDR) ? 0 : -1;
+            case I2C_FUNCS:
+                *static_cast<unsigned long *>(argument) = busFuncs;
+                return 0;
+            case I2C_RDWR: {
+                struct i2c_rdwr_ioctl_data *transfer = static_cast<struct i2c_rdwr_ioctl_data *>(argument);
+                transaction();
+                for (uint32_t i = 0; i < transfer->nmsgs; i++) {
+                    if (transfer->msgs[i].flags & I2C_M_RD) {
+                        deviceRead(transfer->msgs[i].buf, transfer->msgs[i].len);
+                    }
+                    else {
+                        deviceWrite(transfer->msgs[i].buf, transfer->msgs[i].len);
+                    }
+                }
+                return transfer->nmsgs;
+            }
+            default:
+                errno = ENOTTY;
+                return -1;
+        }
+    }
+    
+    int poll(struct pollfd *fds, nfds_t nfds, int timeout) {
+        static int (*real)(struct pollfd *, nfds_t, int);
+        
+        syscalls++;
+        
+        return realFunction(real, "poll")(fds, nfds, timeout);
+    }
+    
+}
+
+// Keeps the compiler from discarding results
+static volatile uint64_t sink;
+
+static void report(const char *name, uint64_t operations, std::chrono::steady_clock::duration elapsed, uint64_t calls) {
+    double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    
+    printf("%-36s %12.1f ns/op %10.2f syscalls/op\n", name, ns / operations, (double)calls / operations);
+}
+
+template <typename F>
+static void bench(const char *name, uint64_t operations, F operation) {
+    
+    // one untimed pass to warm caches and resolve symbols
+    operation(0);
+    
+    uint64_t calls = syscalls;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    
+    for (uint64_t i = 0; i < operations; i++) {
+        operation(i);
+    }
+    
+    std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+    
+    report(name, operations, elapsed, syscalls - calls);
+}
+
+// Sustained sample rate of continuous mode against a simulated sensor, whose ADC keeps its own
+// cycle with its clock running at speed times nominal. The sampler has no INT to follow, as on a
+// board without the line wired, and the light ramps so that every conversion reads differently.
+// Stored samples are counted against the conversions the simulator completed, both in total and per
+// period: more stored than completed means conversions were read twice, fewer that they were missed.
+static void rate(tsl2561IntegrationTime_t time, uint64_t periods, double speed) {
+    
+    uint32_t period = Tsl2561Drv::integrationMicros(time);
+    
+    Tsl2561Sim sim(BENCH_DEVICE_ADDR, speed);
+    std::vector<tsl2561SimPoint_t> ramp = { { 0, 1000, 200 }, { 20000, 100000, 20000 } };
+    sim.setScript(ramp, true);
+    
+    Tsl2561Drv driver("sim", BENCH_DEVICE_ADDR, &sim);
+    driver.setProfile(time, TSL2561_GAIN_16X, false);
+    driver.setHistoryCapacity(periods + 4);
+    driver.resetStats();
+    
+    uint64_t conversions = sim.getConversions();
+    
+    driver.startContinuous();
+    std::this_thread::sleep_for(std::chrono::microseconds(periods * period));
+    driver.stopContinuous();
+    
+    conversions = sim.getConversions() - conversions;
+    uint64_t stored = driver.getStats().conversions;
+    
+    // The rate from the first sample to the last, which leaves out the wait for the first conversion
+    size_t number = driver.getHistorySize();
+    std::vector<double> timestamp(number);
+    std::vector<uint16_t> broadband(number), ir(number), integrationTime(number);
+    std::vector<uint8_t> gain(number);
+    std::vector<uint32_t> lux(number);
+    driver.copyHistory(number, timestamp.data(), broadband.data(), ir.data(), gain.data(), integrationTime.data(), lux.data());
+    
+    double achieved = 0;
+    if (number > 1) {
+        achieved = (number - 1) * 1000.0 / (timestamp[number - 1] - timestamp[0]);
+    }
+    
+    char name[64];
+    snprintf(name, sizeof(name), "continuous rate at %.1f ms", period / 1000.0);
+    
+    printf("%-36s %9.2f Hz %9.2f Hz nominal %6lu stored %6lu converted %6.3f/%.3f per period\n", name, achieved, 1000000.0 / period,
+           (unsigned long)stored, (unsigned long)conversions, (double)stored / periods, (double)conversions / periods);
+}
+
+// Readings spread across the input space: every gain and integration time, channel 0 from dark to
+// saturated, and channel 1 at every ratio segment
+static void luxInputs(std::vector<uint16_t> &broadband, std::vector<uint16_t> &ir, std::vector<uint8_t> &gain, std::vector<uint16_t> &integrationTime) {
+    
+    const uint16_t times[3] = { 13, 101, 402 };
+    const uint8_t gains[2] = { 1, 16 };
+    
+    uint32_t seed = 1;
+    
+    for (int t = 0; t < 3; t++) {
+        for (int g = 0; g < 2; g++) {
+            for (uint32_t channel0 = 0; channel0 < 65536; channel0 += 97) {
+                seed = seed * 1103515245 + 12345;
+                broadband.push_back(channel0);
+                ir.push_back((uint16_t)(((uint64_t)channel0 * ((seed >> 16) % 1400)) / 1024));
+                gain.push_back(gains[g]);
+                integrationTime.push_back(times[t]);
+            }
+        }
+    }
+}
+
+// Compare the batch calculation with the single reading one for channel 0 counts in [from, to)
+// against every channel 1 count. Each row is split in two calls at a point that moves with channel
+// 0, so unaligned starts and every tail length are covered as well.
+static uint64_t checkLuxRows(tsl2561Package_t package, uint8_t gain, uint16_t integrationTime, uint32_t from, uint32_t to) {
+    
+    const size_t rows = 65536;
+    
+    std::vector<uint16_t> broadbands(rows), irs(rows), integrationTimes(rows, integrationTime);
+    std::vector<uint8_t> gains(rows, gain);
+    std::vector<uint32_t> lux(rows);
+    uint64_t mismatches = 0;
+    
+    for (size_t i = 0; i < rows; i++) {
+        irs[i] = i;
+    }
+    
+    for (uint32_t channel0 = from; channel0 < to; channel0++) {
+        std::fill(broadbands.begin(), broadbands.end(), channel0);
+        
+        size_t split = channel0 % 17;
+        Tsl2561Lux::calculate(broadbands.data(), irs.data(), gains.data(), integrationTimes.data(), lux.data(), split, package);
+        Tsl2561Lux::calculate(broadbands.data() + split, irs.data() + split, gains.data() + split, integrationTimes.data() + split, lux.data() + split, rows - split, package);
+        
+        for (size_t i = 0; i < rows; i++) {
+            uint32_t expected = Tsl2561Lux::calculate(channel0, irs[i], gain, integrationTime, package);
+            if (lux[i] != expected) {
+                if (mismatches == 0) {
+                    printf("mismatch: package %d, %ums, %ux, broadband %u, ir %u: batch %u, single %u\n", package, integrationTime, gain, channel0, (unsigned)i, lux[i], expected);
+                }
+                mismatches++;
+            }
+        }
+    }
+    
+    return mismatches;
+}
+
+// Every pair of channel counts at every gain, integration time and package, split across all cores
+static uint64_t checkLux() {
+    
+    const uint16_t times[3] = { 13, 101, 402 };
+    const uint8_t gains[2] = { 1, 16 };
+    const tsl2561Package_t packages[2] = { TSL2561_PACKAGE_T_FN_CL, TSL2561_PACKAGE_CS };
+    
+    unsigned workers = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t mismatches = 0;
+    
+    for (int p = 0; p < 2; p++) {
+        for (int t = 0; t < 3; t++) {
+            for (int g = 0; g < 2; g++) {
+                std::vector<std::thread> threads;
+                std::vector<uint64_t> found(workers, 0);
+                
+                for (unsigned w = 0; w < workers; w++) {
+                    threads.push_back(std::thread([&, w] {
+                        found[w] = checkLuxRows(packages[p], gains[g], times[t], 65536 * w / workers, 65536 * (w + 1) / workers);
+                    }));
+                }
+                
+                uint64_t total = 0;
+                for (unsigned w = 0; w < workers; w++) {
+                    threads[w].join();
+                    total += found[w];
+                }
+                
+                printf("Tsl2561Lux batch %s, package %d, %ums, %ux: %lu mismatches\n", Tsl2561Lux::implementation(), packages[p], times[t], gains[g], (unsigned long)total);
+                fflush(stdout);
+                mismatches += total;
+            }
+        }
+    }
+    
+    return mismatches;
+}
+
+int main(int argc, char *argv[]) {
+    
+    uint64_t iterations = 20000;
+    uint64_t ratePeriods = 0;
+    bool ratePeriodsGiven = false;
+    double rateSpeed = 1.0;
+    bool busThread = false;
+    
+    for (int i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "--latency-us") == 0) && (i + 1 < argc)) {
+            latencyNs = strtoull(argv[++i], NULL, 10) * 1000;
+        }
+        else if ((strcmp(argv[i], "--iterations") == 0) && (i + 1 < argc)) {
+            iterations = strtoull(argv[++i], NULL, 10);
+        }
+        else if ((strcmp(argv[i], "--rate-periods") == 0) && (i + 1 < argc)) {
+            ratePeriods = strtoull(argv[++i], NULL, 10);
+            ratePeriodsGiven = true;
+        }
+        else if ((strcmp(argv[i], "--rate-speed") == 0) && (i + 1 < argc)) {
+            rateSpeed = strtod(argv[++i], NULL);
+        }
+        else if (strcmp(argv[i], "--no-rdwr") == 0) {
+            busFuncs = 0;
+        }
+        else if (strcmp(argv[i], "--bus-thread") == 0) {
+            busThread = true;
+        }
+        else if (strcmp(argv[i], "--check-lux") == 0) {
+            return checkLux() ? 1 : 0;
+        }
+        else {
+            std::cerr << "usage: " << argv[0] << " [--latency-us N] [--iterations N] [--rate-periods N] [--rate-speed X] [--no-rdwr] [--bus-thread] [--check-lux]" << std::endl;
+            return 1;
+        }
+    }
+    
+    if (iterations == 0) {
+        iterations = 1;
+    }
+    
+    // lux calculation
+    std::vector<uint16_t> broadband, ir, integrationTime;
+    std::vector<uint8_t> gain;
+    luxInputs(broadband, ir, gain, integrationTime);
+    size_t rows = broadband.size();
+    std::vector<uint32_t> lux(rows);
+    
+    bench("Tsl2561Lux::calculate", rows * 20, [&](uint64_t i) {
+        size_t row = i % rows;
+        sink += Tsl2561Lux::calculate(broadband[row], ir[row], gain[row], integrationTime[row]);
+    });
+    
+    bench("Tsl2561Lux::calculate CS", rows * 20, [&](uint64_t i) {
+        size_t row = i % rows;
+        sink += Tsl2561Lux::calculate(broadband[row], ir[row], gain[row], integrationTime[row], TSL2561_PACKAGE_CS);
+    });
+    
+    std::string batchName = std::string("Tsl2561Lux::calculate batch ") + Tsl2561Lux::implementation();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < 20; pass++) {
+        Tsl2561Lux::calculate(broadband.data(), ir.data(), gain.data(), integrationTime.data(), lux.data(), rows);
+        sink += lux[pass];
+    }
+    report(batchName.c_str(), rows * 20, std::chrono::steady_clock::now() - start, 0);
+    
+    // formatting
+    bench("DataManip::dataToString(int)", iterations * 10, [](uint64_t i) {
+        sink += DataManip::dataToString((int)i).size();
+    });
+    
+    bench("DataManip::dataToString(float, 2)", iterations * 10, [](uint64_t i) {
+        sink += DataManip::dataToString((float)i * 0.37f, 2).size();
+    });
+    
+    bench("DataManip::dataToString(bool)", iterations * 10, [](uint64_t i) {
+        sink += DataManip::dataToString((bool)(i & 1)).size();
+    });
+    
+    // device paths, against the fake bus
+    readyFile = eventfd(0, EFD_NONBLOCK);
+    
+    registers[TSL2561_REGISTER_ID] = 0x50;
+    registers[TSL2561_REGISTER_CHAN0_LOW] = 0x34;
+    registers[TSL2561_REGISTER_CHAN0_LOW + 1] = 0x12;
+    registers[TSL2561_REGISTER_CHAN0_LOW + 2] = 0x40;
+    registers[TSL2561_REGISTER_CHAN0_LOW + 3] = 0x03;
+    
+    i2cbus::I2CBusTransport bus;
+    Tsl2561Drv driver(BENCH_BUS_FILE, BENCH_DEVICE_ADDR, busThread ? &bus : NULL);
+    
+    if (!driver.isActive()) {
+        std::cerr << "Bench: The driver did not initialize against the fake bus" << std::endl;
+        return 1;
+    }
+    
+    // INT from the fake device stands in for the integration time, so conversions cost only their bus traffic
+    driver.setReadySource(new FdReadySource(readyFile, true));
+    
+    bench("Tsl2561Drv::readRegisters (CH0)", iterations, [&](uint64_t) {
+        unsigned char data[2];
+        driver.readRegisters(TSL2561_COMMAND_BIT | TSL2561_WORD_BIT | TSL2561_REGISTER_CHAN0_LOW, data);
+        sink += data[0];
+    });
+    
+    bench("Tsl2561Drv::getSample (getData)", iterations, [&](uint64_t) {
+        tsl2561Sample_t sample;
+        driver.getSample(sample);
+        sink += sample.lux;
+    });
+    
+    bench("Tsl2561Drv::getValueAtIndex", iterations, [&](uint64_t) {
+        sink += driver.getValueAtIndex(0).size();
+    });
+    
+    bench("Device::getValueByName", iterations, [&](uint64_t) {
+        sink += driver.getValueByName("visible").size();
+    });
+    
+    bench("Tsl2561Drv::getValuesAll", iterations, [&](uint64_t) {
+        deviceValue_t values[Tsl2561Drv::NUM_VALUES];
+        driver.getValuesAll(values);
+        sink += values[0].number;
+    });
+    
+    // continuous mode, paced by the integration time rather than the bus
+    if (!ratePeriodsGiven) {
+        rate(TSL2561_INTEGRATIONTIME_13MS, BENCH_RATE_PERIODS_13MS, rateSpeed);
+        rate(TSL2561_INTEGRATIONTIME_101MS, BENCH_RATE_PERIODS, rateSpeed);
+        rate(TSL2561_INTEGRATIONTIME_402MS, BENCH_RATE_PERIODS, rateSpeed);
+    }
+    else if (ratePeriods > 0) {
+        rate(TSL2561_INTEGRATIONTIME_13MS, ratePeriods, rateSpeed);
+        rate(TSL2561_INTEGRATIONTIME_101MS, ratePeriods, rateSpeed);
+        rate(TSL2561_INTEGRATIONTIME_402MS, ratePeriods, rateSpeed);
+    }
+    
+    return 0;
+}
@@ -1,9 +1,37 @@
 {
+    "variables": {
+        "build_bench%": 0,
+        "build_tests%": 0
+    },
     "targets": [
         {
             "target_name": "tsl2561",
-            "sources": [ "DataManip.cpp", "Device.cpp", "I2CDevice.cpp", "Tsl2561Drv.cpp", "Tsl2561Node.cpp" ],
+            "sources": [ "DataManip.cpp", "Device.cpp", "I2CDevice.cpp", "I2CTransport.cpp", "I2CBusExecutor.cpp", "ReadySource.cpp", "Stats.cpp", "Tsl2561Drv.cpp", "Tsl2561Group.cpp", "Tsl2561History.cpp", "Tsl2561Lux.cpp", "Tsl2561Sim.cpp", "Tsl2561Node.cpp", "Tsl2561GroupNode.cpp" ],
             "cflags": ["-std=c++11", "-Wall"],
         }
+    ],
+    "conditions": [
+        ["build_bench==1", {
+            "targets": [
+                {
+                    "target_name": "tsl2561_bench",
+                    "type": "executable",
+                    "sources": [ "bench/Tsl2561Bench.cpp", "DataManip.cpp", "Device.cpp", "I2CDevice.cpp", "I2CTransport.cpp", "I2CBusExecutor.cpp", "ReadySource.cpp", "Stats.cpp", "Tsl2561Drv.cpp", "Tsl2561History.cpp", "Tsl2561Lux.cpp", "Tsl2561Sim.cpp" ],
+                    "cflags": ["-std=c++11", "-Wall", "-O2"],
+                    "libraries": ["-ldl", "-lpthread"],
+                }
+            ]
+        }],
+        ["build_tests==1", {
+            "targets": [
+                {
+                    "target_name": "tsl2561_test",
+                    "type": "executable",
+                    "sources": [ "test/Tsl2561SimTest.cpp", "DataManip.cpp", "Device.cpp", "I2CDevice.cpp", "I2CTransport.cpp", "I2CBusExecutor.cpp", "ReadySource.cpp", "Stats.cpp", "Tsl2561Drv.cpp", "Tsl2561History.cpp", "Tsl2561Lux.cpp", "Tsl2561Sim.cpp" ],
+                    "cflags": ["-std=c++11", "-Wall"],
+                    "libraries": ["-lpthread"],
+                }
+            ]
+        }]
     ]
 }
@@ -0,0 +1,152 @@
+/**
+ * \file Tsl2561SimTest.cpp
+ *
+ *  Created on 10/16/2026.
+ *  Copyright (c) 2026 Agilatech. All rights reserved.
+ *
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+// Driver behaviour checks against the simulated sensor. Each test prints one line, and the exit
+// status is the number of tests that failed.
+//
+// Usage: tsl2561_test
+
+#include <stdio.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include "../Tsl2561Drv.h"
+#include "../Tsl2561Sim.h"
+
+#define TEST_BUS_FILE             "/dev/tsl2561-sim"
+#define TEST_DEVICE_ADDR          (0x39)
+
+static int failures = 0;
+
+// Poll until the condition holds or the time runs out
+static bool waitFor(std::function<bool()> condition, uint32_t timeoutMs) {
+    
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() >= end) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    
+    return true;
+}
+
+static bool check(bool condition, const char *test, const char *what) {
+    
+    if (!condition) {
+        printf("FAIL %s: %s\n", test, what);
+        failures++;
+    }
+    
+    return condition;
+}
+
+// A watched sensor that drops off the bus long enough to trip the breaker, and comes back from a
+// power loss, must have its window and persistence restored and keep raising events
+static void watchSurvivesBreakerTrip() {
+    
+    const char *name = "watch survives a breaker trip";
+    int before = failures;
+    
+    Tsl2561Sim sim(TEST_DEVICE_ADDR);
+    Tsl2561Drv driver(TEST_BUS_FILE, TEST_DEVICE_ADDR, &sim);
+    
+    // About 550 counts on channel 0 at 13ms and 16x gain
+    sim.setLight(16000, 3200);
+    driver.setProfile(TSL2561_INTEGRATIONTIME_13MS, TSL2561_GAIN_16X, false);
+    driver.setReadySource(sim.interruptSource());
+    driver.setCircuitBreaker(TSL2561_BREAKER_THRESHOLD, 10);
+    
+    std::atomic<int> events(0);
+    
+    if (!check(driver.startWatching(300, 800, 2, [&events](const tsl2561Sample_t &) { events++; }), name, "startWatching failed")) {
+        return;
+    }
+    
+    usleep(100000);
+    
+    if (!check(events == 0, name, "event inside the window before the trip")) {
+        driver.stopWatching();
+        return;
+    }
+    
+    sim.setPresent(false);
+    
+    tsl2561Sample_t sample;
+    for (int i = 0; i < TSL2561_BREAKER_THRESHOLD; i++) {
+        check(!driver.getSample(sample), name, "read succeeded with the sensor gone");
+    }
+    check(driver.isCircuitOpen(), name, "breaker did not trip");
+    
+    sim.setPresent(true);
+    
+    if (check(waitFor([&driver] { return !driver.isCircuitOpen(); }, 1000), name, "breaker did not close after the sensor came back")) {
+        
+        // The default window after a power loss is 0 to 0, which every reading would be outside of
+        usleep(100000);
+        check(events == 0, name, "event inside the window after the trip");
+        
+        // About 1400 counts, above the window
+        sim.setLight(40000, 3200);
+        check(waitFor([&events] { return events > 0; }, 1000), name, "no event after the trip");
+    }
+    
+    driver.stopWatching();
+    
+    if (failures == before) {
+        printf("ok   %s\n", name);
+    }
+}
+
+// The first read in continuous mode must come from the sampler, not from a sample stored before
+static void continuousFirstReadIsFresh() {
+    
+    const char *name = "first continuous read is fresh";
+    int before = failures;
+    
+    Tsl2561Sim sim(TEST_DEVICE_ADDR);
+    Tsl2561Drv driver(TEST_BUS_FILE, TEST_DEVICE_ADDR, &sim);
+    
+    driver.setProfile(TSL2561_INTEGRATIONTIME_13MS, TSL2561_GAIN_16X, false);
+    
+    tsl2561Sample_t sample;
+    sim.setLight(16000, 3200);
+    check(driver.getSample(sample), name, "one-shot read failed");
+    uint16_t stale = sample.broadband;
+    
+    sim.setLight(40000, 3200);
+    
+    if (check(driver.startContinuous(), name, "startContinuous failed")) {
+        check(driver.getSample(sample), name, "continuous read failed");
+        check(sample.broadband != stale, name, "continuous read returned the one-shot sample");
+        driver.stopContinuous();
+    }
+    
+    if (failures == before) {
+        printf("ok   %s\n", name);
+    }
+}
+
+int main() {
+    
+    watchSurvivesBreakerTrip();
+    continuousFirstReadIsFresh();
+    
+    return failures;
+}